@@ -1,4 +1,5 @@
 #include "BaseStationAppFedAvg.h"
+#include <climits>
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/TimeTag_m.h"
 #include "inet/networklayer/common/L3AddressResolver.h"
@@ -7,16 +8,23 @@
 #include "inet/common/packet/Packet.h"
 #include "inet/common/packet/chunk/Chunk.h"
 #include "inet/common/Ptr.h"
+#include "TrafficClass.h"
+#include "ModelDelta.h"
+#include "SyntheticDataset.h"
 
 Define_Module(BaseStationAppFedAvg);
 
 simsignal_t BaseStationAppFedAvg::rcvdPkSignal = registerSignal("rcvdPk");
 
-BaseStationAppFedAvg::BaseStationAppFedAvg() : globalModel(5, 0.01, 32, 3) {
+BaseStationAppFedAvg::BaseStationAppFedAvg() {
 }
 
 BaseStationAppFedAvg::~BaseStationAppFedAvg() {
-    cancelAndDelete(roundTimer);
+    for (auto& job : jobs) {
+        cancelAndDelete(job.roundTimer);
+        delete job.snapshotPacket;
+        delete job.deltaPacket;
+    }
 }
 
 void BaseStationAppFedAvg::initialize(int stage) {
@@ -28,154 +36,594 @@ void BaseStationAppFedAvg::initialize(int stage) {
         fedAvgPort = par("fedAvgPort");
         maxRounds = par("maxRounds");
         roundInterval = par("roundInterval");
+        fedAvgDscp = par("fedAvgDscp");
+        numJobs = par("numJobs");
+        if (numJobs <= 0)
+            throw cRuntimeError("numJobs must be positive");
+        jobStagger = par("jobStagger");
+        gossipMode = par("gossipMode");
+        targetLoss = par("targetLoss");
+        normalizedAggregation = par("normalizedAggregation");
+        pipelinedRounds = par("pipelinedRounds");
+        pipelineQuorum = std::max(1, static_cast<int>(std::ceil(par("quorumFraction").doubleValue() * numUavs)));
+        pipelineDepth = par("pipelineDepth");
+        if (pipelineDepth < 1)
+            throw cRuntimeError("pipelineDepth must be at least 1");
+        stalenessDecay = par("stalenessDecay");
+        validationSamples = par("validationSamples");
+        convergenceEpsilon = par("convergenceEpsilon");
+        convergencePatience = par("convergencePatience");
+        std::string convergenceAction = par("convergenceAction").stdstringValue();
+        if (convergenceAction == "stretch")
+            stretchOnConvergence = true;
+        else if (convergenceAction != "stop")
+            throw cRuntimeError("Unknown convergence action '%s'", convergenceAction.c_str());
+        std::string energyPolicy = par("energyPolicy").stdstringValue();
+        if (energyPolicy == "skip")
+            skipLowBattery = true;
+        else if (energyPolicy == "weight")
+            weightByBattery = true;
+        else if (energyPolicy != "none")
+            throw cRuntimeError("Unknown energy policy '%s'", energyPolicy.c_str());
+        minBatteryLevel = par("minBatteryLevel");
+        roundIntervalStretch = par("roundIntervalStretch");
+        maxRoundInterval = par("maxRoundInterval");
+        acknowledgeUploads = par("acknowledgeUploads");
+        deltaDownlink = par("deltaDownlink");
+        deltaQuantizationStep = par("deltaQuantizationStep");
+        if (deltaQuantizationStep <= 0)
+            throw cRuntimeError("deltaQuantizationStep must be positive");
+        if (jobStagger < SIMTIME_ZERO) {
+            // Par défaut, les tâches se partagent l'intervalle de ronde à parts égales
+            jobStagger = roundInterval / numJobs;
+        }
 
         numReceived = 0;
-        currentRound = 0;
+        totalRoundsCompleted = 0;
+
+        ServerOptimizer::Type optimizerType;
+        if (!ServerOptimizer::parseType(par("serverOptimizer").stdstringValue(), optimizerType))
+            throw cRuntimeError("Unknown server optimizer '%s'", par("serverOptimizer").stringValue());
+
+        jobs.resize(numJobs);
+        for (int i = 0; i < numJobs; i++) {
+            jobs[i].jobId = i;
+            jobs[i].roundInterval = roundInterval;
+            if (validationSamples > 0) {
+                // Jeu de validation tiré du même modèle que les données des UAVs, sans recouvrement
+                jobs[i].validationSet.assign(generateSyntheticValidationSet(i, validationSamples));
+            }
+            jobs[i].optimizer = ServerOptimizer(optimizerType, par("serverLearningRate"), par("serverBeta1"),
+                                                par("serverBeta2"), par("serverTau"));
+        }
 
         roundCompletedSignal = registerSignal("roundCompleted");
         modelAccuracySignal = registerSignal("modelAccuracy");
+        telemetryDelaySignal = registerSignal("telemetryDelay");
+        modelUploadDelaySignal = registerSignal("modelUploadDelay");
+        telemetryBytesSignal = registerSignal("telemetryBytes");
+        fedAvgBytesSignal = registerSignal("fedAvgBytes");
+        consensusDistanceSignal = registerSignal("consensusDistance");
+        downlinkDeltaBytesSignal = registerSignal("downlinkDeltaBytes");
+        downlinkFullBytesSignal = registerSignal("downlinkFullBytes");
+        roundLossSignal = registerSignal("roundLoss");
+        validationLossSignal = registerSignal("validationLoss");
+        validationMseSignal = registerSignal("validationMse");
+        validationR2Signal = registerSignal("validationR2");
+        convergedSignal = registerSignal("converged");
+        lateUpdateStalenessSignal = registerSignal("lateUpdateStaleness");
+        swarmEnergySignal = registerSignal("swarmEnergy");
+        qualityPerJouleSignal = registerSignal("qualityPerJoule");
 
         WATCH(numReceived);
-        WATCH(currentRound);
+        WATCH(totalRoundsCompleted);
     }
     else if (stage == INITSTAGE_APPLICATION_LAYER) {
         socket.setOutputGate(gate("socketOut"));
         socket.setCallback(this);
-        
-        // Only bind the socket here, not in handleStartOperation as well
         socket.bind(localPort);
 
-        // Initialiser le timer pour la première ronde
-        roundTimer = new cMessage("roundTimer");
-        scheduleAt(simTime() + par("startTime"), roundTimer);
+        // Socket FedAvg séparé : les modèles ne partagent pas la file de la télémétrie
+        fedAvgSocket.setOutputGate(gate("socketOut"));
+        fedAvgSocket.setCallback(this);
+        fedAvgSocket.bind(fedAvgPort);
 
-        // Initialiser le modèle global
-        globalModel.initializeWeights();
+        // Initialiser les modèles globaux ; les rondes sont planifiées par handleStartOperation()
+        for (auto& job : jobs) {
+            job.globalModel.seed(intuniform(0, INT_MAX));
+        }
 
         EV_INFO << "Base Station FedAvg initialized. Ready to start federated learning with "
-                << numUavs << " UAVs." << endl;
+                << numUavs << " UAVs and " << numJobs << " jobs." << endl;
+    }
+}
+
+void BaseStationAppFedAvg::scheduleJobs() {
+    // En mode gossip, aucune ronde n'est pilotée par la station de base
+    if (gossipMode)
+        return;
+
+    // Décaler les tâches pour entrelacer leurs phases : pendant que les UAVs envoient
+    // les mises à jour d'une tâche, la station de base diffuse le modèle de la suivante
+    firstRoundStart = simTime() + par("startTime");
+    for (auto& job : jobs) {
+        if (job.roundTimer == nullptr) {
+            job.roundTimer = new cMessage("roundTimer", job.jobId);
+        }
+        scheduleAt(firstRoundStart + jobStagger * job.jobId, job.roundTimer);
     }
 }
 
 void BaseStationAppFedAvg::handleMessageWhenUp(cMessage *msg) {
     if (msg->isSelfMessage()) {
-        if (msg == roundTimer) {
-            startNextRound();
+        FedAvgJob& job = jobs.at(msg->getKind());
+        if (msg == job.roundTimer) {
+            if (pipelinedRounds) {
+                handleRoundTimeout(job);
+            }
+            else {
+                // Échéance de la ronde : agréger les mises à jour reçues sans attendre les UAVs muets
+                // (batterie épuisée, mise à jour perdue)
+                if (!job.roundAggregated && !job.aggregator.empty()) {
+                    EV_INFO << "Round " << job.currentRound << " deadline reached for job " << job.jobId << " with "
+                            << job.aggregator.size() << "/" << job.roundParticipants << " models." << endl;
+                    aggregateModels(job);
+                }
+                startNextRound(job);
+            }
         }
     }
+    else if (fedAvgSocket.belongsToSocket(msg)) {
+        fedAvgSocket.processMessage(msg);
+    }
     else {
         socket.processMessage(msg);
     }
 }
 
-void BaseStationAppFedAvg::startNextRound() {
-    currentRound++;
+void BaseStationAppFedAvg::startNextRound(FedAvgJob& job, const std::set<int> *recipients) {
+    job.currentRound++;
 
-    if (currentRound <= maxRounds) {
-        EV_INFO << "Starting federated learning round " << currentRound << "/" << maxRounds << endl;
+    if (job.currentRound <= maxRounds) {
+        EV_INFO << "Starting federated learning round " << job.currentRound << "/" << maxRounds
+                << " for job " << job.jobId << endl;
 
         // Réinitialiser les modèles reçus pour cette ronde
-        receivedModels.clear();
-        samplesPerUav.clear();
+        job.aggregator.clear();
+        job.roundAggregated = false;
+        job.roundLossSum = 0;
+        job.roundLossSamples = 0;
+        if (pipelinedRounds) {
+            job.pipeline[job.currentRound] = PipelinedRound();
+        }
 
-        // Diffuser le modèle global à tous les UAVs
-        broadcastGlobalModel();
+        // Diffuser le modèle global aux UAVs (tous, ou ceux qui ont déjà répondu en mode pipeliné)
+        broadcastGlobalModel(job, recipients);
 
-        // Planifier la prochaine ronde
-        scheduleAt(simTime() + roundInterval, roundTimer);
+        // Planifier la prochaine ronde ; en mode pipeliné, ce timer ne sert que de délai maximal
+        cancelEvent(job.roundTimer);
+        scheduleAt(simTime() + job.roundInterval, job.roundTimer);
     }
     else {
-        EV_INFO << "Federated learning completed after " << (currentRound-1) << " rounds." << endl;
+        EV_INFO << "Federated learning completed after " << (job.currentRound-1) << " rounds for job "
+                << job.jobId << "." << endl;
+    }
+}
+
+void BaseStationAppFedAvg::broadcastGlobalModel(FedAvgJob& job, const std::set<int> *recipients) {
+    // Chaque diffusion publie une nouvelle version du modèle global
+    job.modelVersion++;
+    job.roundDeadline = simTime() + job.roundInterval;
+
+    // Les UAVs qui détiennent la version précédente ne reçoivent que le delta quantifié ;
+    // la reconstruction qu'ils en font devient la référence du delta suivant
+    delete job.deltaPacket;
+    job.deltaPacket = nullptr;
+    if (deltaDownlink && !job.deliveredModel.empty()) {
+        std::string delta = encodeModelDelta(job.globalModel.getWeights(), job.deliveredModel, deltaQuantizationStep);
+        job.deltaPacket = createGlobalModelPacket(job, job.modelVersion - 1, delta);
+    }
+    else {
+        // Référence exacte des UAVs : les poids tels qu'ils les décodent de la version complète
+        FederatedLearningModel::parseWeights(job.globalModel.serialize(), job.deliveredModel);
+    }
+
+    // Un seul paquet par forme de la version : chaque UAV en reçoit un duplicata qui partage le chunk
+    delete job.snapshotPacket;
+    job.snapshotPacket = createGlobalModelPacket(job, -1, serializeDeliveredModel(job));
+    job.roundParticipants = 0;
+
+    // Diffuser le modèle à tous les UAVs (via multicast ou multiples unicast)
+    for (int i = 0; i < numUavs; i++) {
+        if (recipients != nullptr && recipients->count(i) == 0) {
+            continue;
+        }
+
+        // Dans un cas réel, nous utiliserions des adresses multicast ou nous enverrions
+        // à chaque UAV individuellement en utilisant leur adresse
+        std::string destAddr = "uav[" + std::to_string(i) + "]";
+        L3Address destAddress;
+        L3AddressResolver().tryResolve(destAddr.c_str(), destAddress);
+
+        if (!destAddress.isUnspecified() && sendCurrentModel(job, i, destAddress)) {
+            job.roundParticipants++;
+        }
     }
 }
 
-void BaseStationAppFedAvg::broadcastGlobalModel() {
+bool BaseStationAppFedAvg::sendCurrentModel(FedAvgJob& job, int uavId, L3Address destAddr) {
+    // Un UAV à batterie faible n'est plus sollicité : sans modèle, il ne s'entraîne pas.
+    // Un UAV à batterie épuisée ne répondrait pas : il est exclu quelle que soit la politique
+    auto battery = uavBatteryLevels.find(uavId);
+    if (battery != uavBatteryLevels.end() && (battery->second <= 0 || (skipLowBattery && battery->second < minBatteryLevel))) {
+        EV_INFO << "Skipping UAV " << uavId << " for job " << job.jobId << ", battery level "
+                << battery->second << endl;
+        numLowBatterySkips++;
+        return false;
+    }
+
+    auto it = job.uavVersions.find(uavId);
+    bool upToDate = job.deltaPacket != nullptr && it != job.uavVersions.end() && it->second == job.modelVersion - 1;
+    sendGlobalModel(job, uavId, destAddr, upToDate ? job.deltaPacket : job.snapshotPacket);
+
+    EV_INFO << "Sent global model version " << job.modelVersion << (upToDate ? " (delta)" : "")
+            << " to UAV " << uavId << " for job " << job.jobId << ", round " << job.currentRound << endl;
+    return true;
+}
+
+std::string BaseStationAppFedAvg::serializeDeliveredModel(const FedAvgJob& job) {
+    FederatedLearningModel snapshotModel(job.globalModel);
+    snapshotModel.setWeights(job.deliveredModel);
+    return snapshotModel.serialize();
+}
+
+Packet *BaseStationAppFedAvg::createGlobalModelPacket(FedAvgJob& job, int baseVersion, const std::string& weights) {
     // Créer un paquet avec le message FedAvg
-    char msgName[32];
-    sprintf(msgName, "GlobalModel-Round%d", currentRound);
+    char msgName[64];
+    sprintf(msgName, "%s-Job%d-Round%d", baseVersion >= 0 ? "GlobalDelta" : "GlobalModel",
+            job.jobId, job.currentRound);
     Packet *packet = new Packet(msgName);
 
     // Créer le message FedAvg
     const auto& fedAvgMsg = makeShared<FedAvgMessage>();
     fedAvgMsg->setMessageType(GLOBAL_UPDATE);
-    fedAvgMsg->setRoundId(currentRound);
-    fedAvgMsg->setModelWeights(globalModel.serialize().c_str());
+    fedAvgMsg->setJobId(job.jobId);
+    fedAvgMsg->setRoundId(job.currentRound);
+    fedAvgMsg->setModelWeights(weights.c_str());
     fedAvgMsg->setUavId(-1);  // -1 signifie station de base
+    fedAvgMsg->setRoundDeadline(job.roundDeadline);
+    fedAvgMsg->setModelVersion(job.modelVersion);
+    fedAvgMsg->setBaseVersion(baseVersion);
+    if (baseVersion >= 0) {
+        fedAvgMsg->setDeltaStep(deltaQuantizationStep);
+    }
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
 
     // Ajouter le message au paquet
     packet->insertAtBack(fedAvgMsg);
+    setTrafficClass(packet, fedAvgDscp);
+    return packet;
+}
 
-    // Diffuser le paquet à tous les UAVs (via multicast ou multiples unicast)
-    for (int i = 0; i < numUavs; i++) {
-        // Dans un cas réel, nous utiliserions des adresses multicast ou nous enverrions
-        // à chaque UAV individuellement en utilisant leur adresse
-        std::string destAddr = "uav[" + std::to_string(i) + "]";
-        L3Address destAddress;
-        L3AddressResolver().tryResolve(destAddr.c_str(), destAddress);
+void BaseStationAppFedAvg::sendGlobalModel(FedAvgJob& job, int uavId, L3Address destAddr, const Packet *model) {
+    // Le duplicata partage le chunk immuable du modèle ; seul le nom du paquet désigne l'UAV
+    Packet *packet = model->dup();
+    std::string name = std::string(model->getName()) + "-UAV" + std::to_string(uavId);
+    packet->setName(name.c_str());
 
-        if (!destAddress.isUnspecified()) {
-            // Créer une copie du paquet pour chaque UAV
-            Packet *pktCopy = packet->dup();
-            socket.sendTo(pktCopy, destAddress, fedAvgPort);
-            EV_INFO << "Sent global model to UAV " << i << " for round " << currentRound << endl;
-        }
-    }
+    emit(model == job.deltaPacket ? downlinkDeltaBytesSignal : downlinkFullBytesSignal, B(packet->getDataLength()).get());
+    fedAvgBytesSent += B(packet->getDataLength()).get();
+    fedAvgSocket.sendTo(packet, destAddr, fedAvgPort);
+}
 
-    // Supprimer le paquet original
-    delete packet;
+void BaseStationAppFedAvg::sendUploadAck(int jobId, int uavId, int roundId, L3Address destAddr) {
+    char msgName[64];
+    sprintf(msgName, "UploadAck-UAV%d-Job%d-Round%d", uavId, jobId, roundId);
+    Packet *packet = new Packet(msgName);
+
+    const auto& fedAvgMsg = makeShared<FedAvgMessage>();
+    fedAvgMsg->setMessageType(UPLOAD_ACK);
+    fedAvgMsg->setJobId(jobId);
+    fedAvgMsg->setRoundId(roundId);
+    fedAvgMsg->setUavId(uavId);
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
+
+    packet->insertAtBack(fedAvgMsg);
+    setTrafficClass(packet, fedAvgDscp);
+    fedAvgBytesSent += B(packet->getDataLength()).get();
+    fedAvgSocket.sendTo(packet, destAddr, fedAvgPort);
 }
 
-void BaseStationAppFedAvg::aggregateModels() {
-    if (receivedModels.empty()) {
+void BaseStationAppFedAvg::aggregateModels(FedAvgJob& job) {
+    FedAvgAggregator& aggregator = job.aggregator;
+    int currentRound = job.currentRound;
+
+    if (aggregator.empty()) {
         EV_WARN << "No models received for aggregation in round " << currentRound << endl;
         return;
     }
 
-    EV_INFO << "Aggregating " << receivedModels.size() << " models for round " << currentRound << endl;
+    EV_INFO << "Aggregating " << aggregator.size() << " models for job " << job.jobId
+            << ", round " << currentRound << endl;
 
-    // Calculer le nombre total d'échantillons
-    int totalSamples = 0;
-    for (const auto& entry : samplesPerUav) {
-        totalSamples += entry.second;
-    }
-
-    if (totalSamples == 0) {
+    if (aggregator.getTotalSamples() == 0) {
         EV_WARN << "Total samples count is zero, cannot perform weighted aggregation" << endl;
         return;
     }
 
-    // Obtenir les dimensions du modèle à partir du premier modèle
-    FederatedLearningModel tempModel;
-    tempModel.deserialize(receivedModels.begin()->second);
-    std::vector<double> aggregatedWeights(tempModel.getWeights().size(), 0.0);
+    job.lastAverage.clear();
 
-    // Agréger les modèles avec une moyenne pondérée
-    for (const auto& entry : receivedModels) {
-        int uavId = entry.first;
-        const std::string& modelStr = entry.second;
-        int samples = samplesPerUav[uavId];
+    // Agréger les modèles avec une moyenne pondérée par le nombre d'échantillons ; en mode normalisé,
+    // les mises à jour sont ramenées au même nombre de pas à partir du modèle diffusé aux UAVs
+    std::vector<double> aggregatedWeights;
+    if (normalizedAggregation && job.deliveredModel.size() == job.globalModel.getWeights().size()) {
+        aggregatedWeights = aggregator.aggregateNormalized(job.deliveredModel);
+    }
+    else {
+        aggregatedWeights = aggregator.aggregate();
+    }
 
-        // Désérialiser le modèle
-        FederatedLearningModel uavModel;
-        if (uavModel.deserialize(modelStr)) {
-            // Pondérer par le nombre d'échantillons
-            double weight = static_cast<double>(samples) / totalSamples;
-            const auto& uavWeights = uavModel.getWeights();
+    job.lastAverage = aggregatedWeights;
 
-            // Ajouter à la moyenne pondérée
-            for (size_t i = 0; i < aggregatedWeights.size(); i++) {
-                aggregatedWeights[i] += uavWeights[i] * weight;
-            }
-        }
+    // La moyenne moins le modèle global sert de pseudo-gradient à l'optimiseur du serveur
+    std::vector<double> weights = job.globalModel.getWeights();
+    job.optimizer.step(weights, aggregatedWeights);
+    job.globalModel.setWeights(weights);
+
+    // Perte de la ronde : MAE moyenne rapportée par les UAVs sur leurs propres données
+    double loss = -1;
+    if (job.roundLossSamples > 0) {
+        loss = job.roundLossSum / job.roundLossSamples;
+        emit(roundLossSignal, loss);
     }
 
-    // Mettre à jour le modèle global avec les poids agrégés
-    globalModel.setWeights(aggregatedWeights);
+    // Avec un jeu de validation, la perte de référence est celle du modèle global agrégé
+    if (!job.validationSet.empty()) {
+        loss = evaluateGlobalModel(job).mae;
+    }
+    emitEnergyEfficiency(loss);
+
+    // Premier passage sous la perte visée
+    if (loss >= 0 && targetLoss >= 0 && job.roundsToTarget < 0 && loss <= targetLoss) {
+        job.roundsToTarget = currentRound;
+        job.bytesToTarget = fedAvgBytesReceived + fedAvgBytesSent;
+    }
 
     // Émettre un signal de progression
     emit(roundCompletedSignal, currentRound);
+    totalRoundsCompleted++;
+    lastRoundCompletion = simTime();
 
     EV_INFO << "Model aggregation completed for round " << currentRound << endl;
+
+    if (!job.validationSet.empty()) {
+        checkConvergence(job, loss);
+    }
+}
+
+void BaseStationAppFedAvg::tryAdvancePipeline(FedAvgJob& job) {
+    int currentRound = job.currentRound;
+    auto it = job.pipeline.find(currentRound);
+
+    // Agrégation spéculative dès que le quorum de la ronde actuelle est atteint
+    if (it != job.pipeline.end() && !it->second.aggregated) {
+        if (job.aggregator.size() < pipelineQuorum)
+            return;
+
+        EV_INFO << "Quorum of " << job.aggregator.size() << "/" << numUavs << " reached for job " << job.jobId
+                << ", round " << currentRound << ". Aggregating speculatively." << endl;
+        aggregateModels(job);
+        it->second.aggregated = true;
+        it->second.average = job.lastAverage;
+        it->second.totalSamples = job.aggregator.getTotalSamples();
+    }
+
+    // Tâche arrêtée sur convergence, ou dernière ronde déjà ouverte : plus aucune ronde n'est ouverte.
+    // Les mises à jour tardives restent intégrées jusqu'au délai de la dernière ronde, qui termine la tâche
+    if (job.convergedRound >= 0 || currentRound >= maxRounds)
+        return;
+
+    // Fermer les rondes dont tous les UAVs ont répondu
+    for (auto round = job.pipeline.begin(); round != job.pipeline.end(); ) {
+        if (round->second.aggregated && static_cast<int>(round->second.reporters.size()) >= numUavs) {
+            round = job.pipeline.erase(round);
+        }
+        else {
+            ++round;
+        }
+    }
+
+    // La ronde suivante n'est ouverte que si la profondeur du pipeline le permet ;
+    // elle est diffusée aux UAVs qui ont répondu, les retardataires la recevront avec leur mise à jour
+    int oldestOpenRound = job.pipeline.empty() ? currentRound + 1 : job.pipeline.begin()->first;
+    if (currentRound + 1 - oldestOpenRound >= pipelineDepth)
+        return;
+
+    it = job.pipeline.find(currentRound);
+    if (it != job.pipeline.end()) {
+        std::set<int> recipients = it->second.reporters;
+        startNextRound(job, &recipients);
+    }
+    else {
+        startNextRound(job);
+    }
+}
+
+void BaseStationAppFedAvg::processLateUpdate(FedAvgJob& job, const FedAvgMessage *msg, L3Address srcAddr) {
+    int uavId = msg->getUavId();
+    int roundId = msg->getRoundId();
+
+    auto it = job.pipeline.find(roundId);
+    if (it == job.pipeline.end() || !it->second.aggregated) {
+        EV_WARN << "Received model update for closed round " << roundId
+                << " but current round is " << job.currentRound << endl;
+        if (roundId < job.currentRound) {
+            // Resynchroniser l'UAV sur la ronde actuelle
+            numStaleUpdatesDropped++;
+            if (job.currentRound <= maxRounds && job.convergedRound < 0) {
+                sendCurrentModel(job, uavId, srcAddr);
+            }
+        }
+        return;
+    }
+
+    PipelinedRound& round = it->second;
+    if (round.reporters.count(uavId) > 0) {
+        EV_INFO << "Ignoring duplicate model update from UAV " << uavId << " for round " << roundId << endl;
+        return;
+    }
+    round.reporters.insert(uavId);
+
+    // Correction : ajouter au modèle global la contribution qu'aurait eue la mise à jour dans la moyenne
+    // de sa ronde, atténuée selon le nombre de rondes ouvertes depuis
+    FederatedLearningModel lateModel(job.globalModel);
+    int samples = getParticipationSamples(msg);
+    if (lateModel.deserialize(msg->getModelWeights()) && samples > 0 &&
+            round.average.size() == lateModel.getWeights().size()) {
+        double share = static_cast<double>(samples) / (round.totalSamples + samples);
+        int staleness = job.currentRound - roundId;
+        double factor = share * std::pow(stalenessDecay, staleness);
+
+        std::vector<double> weights = job.globalModel.getWeights();
+        const std::vector<double>& lateWeights = lateModel.getWeights();
+        for (size_t i = 0; i < weights.size(); i++) {
+            double diff = lateWeights[i] - round.average[i];
+            weights[i] += factor * diff;
+            round.average[i] += share * diff;
+        }
+        round.totalSamples += samples;
+        job.globalModel.setWeights(weights);
+
+        numLateUpdatesFolded++;
+        emit(lateUpdateStalenessSignal, staleness);
+
+        EV_INFO << "Folded late update from UAV " << uavId << " for round " << roundId
+                << " (staleness " << staleness << ") into job " << job.jobId << endl;
+    }
+
+    // L'UAV retardataire reprend directement à la ronde actuelle
+    if (roundId < job.currentRound && job.currentRound <= maxRounds && job.convergedRound < 0) {
+        sendCurrentModel(job, uavId, srcAddr);
+    }
+
+    tryAdvancePipeline(job);
+}
+
+void BaseStationAppFedAvg::handleRoundTimeout(FedAvgJob& job) {
+    // Délai de ronde écoulé sans quorum, ou UAVs injoignables : agréger ce qui est arrivé,
+    // fermer les rondes ouvertes et resynchroniser tous les UAVs
+    auto it = job.pipeline.find(job.currentRound);
+    if (it != job.pipeline.end() && !it->second.aggregated && !job.aggregator.empty()) {
+        aggregateModels(job);
+    }
+    job.pipeline.clear();
+    startNextRound(job);
+}
+
+ValidationMetrics BaseStationAppFedAvg::evaluateGlobalModel(FedAvgJob& job) {
+    ValidationMetrics metrics = job.validationSet.evaluate(job.globalModel.getWeights());
+
+    emit(validationLossSignal, metrics.mae);
+    emit(validationMseSignal, metrics.mse);
+    emit(validationR2Signal, metrics.r2);
+
+    EV_INFO << "Job " << job.jobId << " validation: MAE " << metrics.mae << ", MSE " << metrics.mse
+            << ", R2 " << metrics.r2 << endl;
+    return metrics;
+}
+
+void BaseStationAppFedAvg::checkConvergence(FedAvgJob& job, double loss) {
+    if (job.bestLoss < 0 || loss < job.bestLoss - convergenceEpsilon) {
+        job.bestLoss = loss;
+        job.roundsWithoutImprovement = 0;
+        return;
+    }
+
+    job.roundsWithoutImprovement++;
+    if (convergencePatience <= 0 || job.roundsWithoutImprovement < convergencePatience)
+        return;
+
+    job.roundsWithoutImprovement = 0;
+    emit(convergedSignal, job.currentRound);
+
+    if (stretchOnConvergence) {
+        // Les rondes suivantes sont espacées : moins de temps d'antenne pour un modèle qui n'évolue plus
+        job.roundInterval = std::min(job.roundInterval * roundIntervalStretch, maxRoundInterval);
+        EV_INFO << "Job " << job.jobId << " converged at round " << job.currentRound
+                << ", round interval stretched to " << job.roundInterval << "s" << endl;
+    }
+    else {
+        // Arrêter la tâche : la ronde suivante, déjà planifiée, est annulée
+        cancelEvent(job.roundTimer);
+        job.convergedRound = job.currentRound;
+        EV_INFO << "Job " << job.jobId << " converged at round " << job.currentRound
+                << " (best validation loss " << job.bestLoss << "), stopping federated learning" << endl;
+    }
+}
+
+void BaseStationAppFedAvg::sampleConsensus(FedAvgJob& job, const FedAvgMessage *msg) {
+    int uavId = msg->getUavId();
+    if (!job.consensusSamples.addSerializedModel(uavId, msg->getModelWeights(), msg->getSamplesCount())) {
+        EV_WARN << "Cannot deserialize consensus sample from UAV " << uavId << endl;
+        return;
+    }
+
+    // Le modèle de consensus est la moyenne des derniers modèles échantillonnés ;
+    // leur distance moyenne à ce modèle mesure le désaccord restant dans l'essaim
+    std::vector<double> consensus = job.consensusSamples.aggregate();
+    if (consensus.empty())
+        return;
+    job.globalModel.setWeights(consensus);
+    if (!job.validationSet.empty()) {
+        emitEnergyEfficiency(evaluateGlobalModel(job).mae);
+    }
+    else if (msg->getAccuracy() > 0) {
+        emitEnergyEfficiency(1.0 / msg->getAccuracy() - 1.0);
+    }
+
+    emit(consensusDistanceSignal, job.consensusSamples.meanDistanceTo(consensus));
+    if (msg->getAccuracy() > 0) {
+        emit(modelAccuracySignal, msg->getAccuracy());
+    }
+
+    EV_INFO << "Consensus sample from UAV " << uavId << " for job " << job.jobId
+            << " (gossip round " << msg->getRoundId() << ")" << endl;
+}
+
+void BaseStationAppFedAvg::updateUavEnergy(const FedAvgMessage *msg) {
+    int uavId = msg->getUavId();
+    if (msg->getBatteryLevel() >= 0) {
+        uavBatteryLevels[uavId] = msg->getBatteryLevel();
+    }
+    if (msg->getEnergyConsumed() > 0) {
+        uavEnergyConsumed[uavId] = msg->getEnergyConsumed();
+    }
+}
+
+int BaseStationAppFedAvg::getParticipationSamples(const FedAvgMessage *msg) const {
+    // Un UAV à batterie faible risque de quitter l'essaim : le modèle global s'appuie moins sur ses données
+    int samples = msg->getSamplesCount();
+    double batteryLevel = msg->getBatteryLevel();
+    if (weightByBattery && batteryLevel >= 0 && batteryLevel < minBatteryLevel && samples > 0) {
+        samples = std::max(1, static_cast<int>(std::round(samples * batteryLevel / minBatteryLevel)));
+    }
+    return samples;
+}
+
+void BaseStationAppFedAvg::emitEnergyEfficiency(double loss) {
+    // Énergie de l'essaim : somme des derniers cumuls rapportés par chaque UAV, toutes tâches confondues
+    double swarmEnergy = 0;
+    for (const auto& entry : uavEnergyConsumed) {
+        swarmEnergy += entry.second;
+    }
+    if (swarmEnergy <= 0 || loss < 0)
+        return;
+
+    // Qualité du modèle global (1 / (1 + MAE), comme la précision des UAVs) par joule dépensé
+    emit(swarmEnergySignal, swarmEnergy);
+    emit(qualityPerJouleSignal, 1.0 / (1.0 + loss) / swarmEnergy);
 }
 
 void BaseStationAppFedAvg::socketDataArrived(UdpSocket *socket, Packet *packet) {
@@ -183,9 +631,8 @@ void BaseStationAppFedAvg::socketDataArrived(UdpSocket *socket, Packet *packet)
     auto addressInd = packet->getTag<L3AddressInd>();
     L3Address srcAddr = addressInd->getSrcAddress();
 
-    // Calculer le délai de bout en bout
-    auto creationTimeTag = packet->getTag<CreationTimeTag>();
-    simtime_t delay = simTime() - creationTimeTag->getCreationTime();
+    // Calculer le délai de bout en bout (depuis le plus ancien relevé transporté)
+    simtime_t delay = simTime() - getOldestCreationTime(packet->peekData());
 
     EV_INFO << "Received packet " << packet->getName() << " from UAV at "
             << srcAddr.str() << ". Delay: " << delay << "s" << endl;
@@ -195,45 +642,134 @@ void BaseStationAppFedAvg::socketDataArrived(UdpSocket *socket, Packet *packet)
     packetsPerUAV[srcAddr]++;
     emit(rcvdPkSignal, packet);
 
-    // Traiter le message FedAvg s'il en contient un
-    auto chunk = packet->peekAtFront<Chunk>();
-    if (auto fedAvgMsg = dynamicPtrCast<const FedAvgMessage>(chunk)) {
+    if (socket == &fedAvgSocket) {
+        // Le message FedAvg est en tête ; la télémétrie éventuelle le suit
+        auto chunk = packet->peekAtFront<Chunk>();
+        auto fedAvgMsg = dynamicPtrCast<const FedAvgMessage>(chunk);
+        if (fedAvgMsg == nullptr) {
+            EV_WARN << "Dropping packet " << packet->getName() << " without FedAvg message on port "
+                    << fedAvgPort << endl;
+            delete packet;
+            return;
+        }
+
+        fedAvgBytesReceived += B(packet->getDataLength()).get();
+        emit(fedAvgBytesSignal, B(packet->getDataLength()).get());
+        packet->popAtFront(fedAvgMsg->getChunkLength());
+
+        if (fedAvgMsg->getMessageType() == LOCAL_UPDATE) {
+            emit(modelUploadDelaySignal, simTime() - getOldestCreationTime(fedAvgMsg));
+        }
+
+        if (fedAvgMsg->getTelemetrySamples() > 0 && packet->getDataLength() > b(0)) {
+            processTelemetry(packet->peekData());
+        }
         processFedAvgMessage(fedAvgMsg.get()->dup(), srcAddr);
     }
+    else {
+        processTelemetry(packet->peekData());
+    }
 
     delete packet;
 }
 
+void BaseStationAppFedAvg::processTelemetry(const Ptr<const Chunk>& data) {
+    // Chaque relevé porte son propre horodatage, y compris dans une trame groupée
+    for (const auto& region : data->getAllTags<CreationTimeTag>()) {
+        emit(telemetryDelaySignal, simTime() - region.getTag()->getCreationTime());
+        telemetryReadingsReceived++;
+    }
+
+    telemetryBytesReceived += B(data->getChunkLength()).get();
+    emit(telemetryBytesSignal, B(data->getChunkLength()).get());
+}
+
 void BaseStationAppFedAvg::processFedAvgMessage(FedAvgMessage *msg, L3Address srcAddr) {
+    int jobId = msg->getJobId();
+    if (jobId < 0 || jobId >= numJobs) {
+        EV_WARN << "Ignoring FedAvg message for unknown job " << jobId << endl;
+        delete msg;
+        return;
+    }
+    FedAvgJob& job = jobs[jobId];
+    FedAvgAggregator& aggregator = job.aggregator;
+    int currentRound = job.currentRound;
+
     if (msg->getMessageType() == LOCAL_UPDATE) {
         int uavId = msg->getUavId();
         int roundId = msg->getRoundId();
 
-        if (roundId == currentRound) {
+        // Acquitter chaque réception, y compris les retransmissions dont l'accusé a été perdu
+        if (acknowledgeUploads) {
+            sendUploadAck(jobId, uavId, roundId, srcAddr);
+        }
+
+        // La mise à jour indique la version du modèle global détenue par l'UAV, et son énergie
+        job.uavVersions[uavId] = msg->getModelVersion();
+        updateUavEnergy(msg);
+
+        // En mode pipeliné, une ronde agrégée au quorum ne reçoit plus que des mises à jour tardives
+        auto pipelined = job.pipeline.find(roundId);
+        bool collecting = roundId == currentRound && (pipelined == job.pipeline.end() || !pipelined->second.aggregated);
+
+        if (collecting && aggregator.contains(uavId)) {
+            EV_INFO << "Ignoring duplicate model update from UAV " << uavId
+                   << " for round " << roundId << endl;
+        }
+        else if (collecting) {
             EV_INFO << "Received model update from UAV " << uavId
                    << " for round " << roundId << endl;
 
             // Stocker le modèle reçu
-            receivedModels[uavId] = msg->getModelWeights();
-            samplesPerUav[uavId] = msg->getSamplesCount();
+            if (!aggregator.addSerializedModel(uavId, msg->getModelWeights(), getParticipationSamples(msg), msg->getLocalSteps())) {
+                EV_WARN << "Cannot deserialize model update from UAV " << uavId << endl;
+            }
 
-            // Émettre signal de précision si disponible
+            // Émettre signal de précision si disponible ; précision = 1 / (1 + MAE)
             double accuracy = msg->getAccuracy();
             if (accuracy > 0) {
                 emit(modelAccuracySignal, accuracy);
+                job.roundLossSum += (1.0 / accuracy - 1.0) * msg->getSamplesCount();
+                job.roundLossSamples += msg->getSamplesCount();
             }
 
-            // Si nous avons reçu les modèles de tous les UAVs, agréger
-            if (static_cast<int>(receivedModels.size()) == numUavs) {
-                EV_INFO << "Received models from all UAVs. Starting aggregation." << endl;
-                aggregateModels();
+            if (pipelinedRounds) {
+                if (pipelined != job.pipeline.end()) {
+                    pipelined->second.reporters.insert(uavId);
+                }
+                tryAdvancePipeline(job);
+            }
+            // Si nous avons reçu les modèles de tous les UAVs sollicités, agréger
+            else if (!job.roundAggregated && aggregator.size() >= job.roundParticipants) {
+                EV_INFO << "Received models from all participating UAVs. Starting aggregation." << endl;
+                aggregateModels(job);
+                job.roundAggregated = true;
             }
         }
+        else if (pipelinedRounds) {
+            processLateUpdate(job, msg, srcAddr);
+        }
         else {
             EV_WARN << "Received model update for round " << roundId
                    << " but current round is " << currentRound << endl;
         }
     }
+    else if (msg->getMessageType() == SNAPSHOT_REQUEST) {
+        // Un UAV qui a manqué une version ne peut pas appliquer le delta : lui envoyer la version complète
+        int uavId = msg->getUavId();
+        numSnapshotRequests++;
+        job.uavVersions[uavId] = msg->getModelVersion();
+
+        if (job.modelVersion > 0 && msg->getModelVersion() != job.modelVersion) {
+            EV_INFO << "UAV " << uavId << " holds model version " << msg->getModelVersion()
+                    << ", sending snapshot of version " << job.modelVersion << " for job " << jobId << endl;
+            sendGlobalModel(job, uavId, srcAddr, job.snapshotPacket);
+        }
+    }
+    else if (msg->getMessageType() == CONSENSUS_SAMPLE) {
+        updateUavEnergy(msg);
+        sampleConsensus(job, msg);
+    }
 
     delete msg;
 }
@@ -244,40 +780,81 @@ void BaseStationAppFedAvg::socketErrorArrived(UdpSocket *socket, Indication *ind
 }
 
 void BaseStationAppFedAvg::socketClosed(UdpSocket *socket) {
-    if (operationalState == State::STOPPING_OPERATION) {
+    if (operationalState == State::STOPPING_OPERATION && !this->socket.isOpen() && !fedAvgSocket.isOpen()) {
         startActiveOperationExtraTimeOrFinish(par("stopOperationExtraTime"));
     }
 }
 
 void BaseStationAppFedAvg::handleStartOperation(LifecycleOperation *operation) {
+    // Les sockets sont liés une seule fois, dans initialize()
     socket.setOutputGate(gate("socketOut"));
-    // Remove the duplicate socket binding from here
     socket.setCallback(this);
+    fedAvgSocket.setOutputGate(gate("socketOut"));
+    fedAvgSocket.setCallback(this);
 
-    roundTimer = new cMessage("roundTimer");
-    scheduleAt(simTime() + par("startTime"), roundTimer);
+    scheduleJobs();
 }
 
 void BaseStationAppFedAvg::handleStopOperation(LifecycleOperation *operation) {
-    cancelEvent(roundTimer);
+    for (auto& job : jobs) {
+        cancelEvent(job.roundTimer);
+    }
     socket.close();
+    fedAvgSocket.close();
     delayActiveOperationFinish(par("stopOperationTimeout"));
 }
 
 void BaseStationAppFedAvg::handleCrashOperation(LifecycleOperation *operation) {
-    cancelEvent(roundTimer);
+    for (auto& job : jobs) {
+        cancelEvent(job.roundTimer);
+    }
     socket.destroy();
+    fedAvgSocket.destroy();
 }
 
 void BaseStationAppFedAvg::finish() {
     ApplicationBase::finish();
 
     EV_INFO << "Base Station FedAvg Application finished." << endl;
-    EV_INFO << "Completed " << currentRound << " rounds of federated learning." << endl;
+    EV_INFO << "Completed " << totalRoundsCompleted << " rounds of federated learning over "
+            << numJobs << " jobs." << endl;
     EV_INFO << "Received " << numReceived << " packets in total." << endl;
     EV_INFO << "Packets received from each UAV:" << endl;
 
     for (auto& pair : packetsPerUAV) {
         EV_INFO << "  UAV at " << pair.first.str() << ": " << pair.second << " packets" << endl;
     }
+
+    // Débit par classe de trafic sur la durée de la simulation
+    double duration = (simTime() - par("startTime")).dbl();
+    if (duration > 0) {
+        recordScalar("telemetryThroughput", telemetryBytesReceived * 8 / duration, "bps");
+        recordScalar("fedAvgThroughput", fedAvgBytesReceived * 8 / duration, "bps");
+    }
+    recordScalar("telemetryReadingsReceived", telemetryReadingsReceived);
+    recordScalar("snapshotRequests", numSnapshotRequests);
+    if (skipLowBattery || numLowBatterySkips > 0) {
+        recordScalar("lowBatterySkips", numLowBatterySkips);
+    }
+    if (pipelinedRounds) {
+        recordScalar("lateUpdatesFolded", numLateUpdatesFolded);
+        recordScalar("staleUpdatesDropped", numStaleUpdatesDropped);
+    }
+
+    // Débit agrégé de l'apprentissage, toutes tâches confondues
+    recordScalar("roundsCompleted", totalRoundsCompleted);
+    for (const auto& job : jobs) {
+        if (job.roundsToTarget > 0) {
+            std::string suffix = numJobs > 1 ? ":job" + std::to_string(job.jobId) : "";
+            recordScalar(("roundsToTarget" + suffix).c_str(), job.roundsToTarget);
+            recordScalar(("bytesToTarget" + suffix).c_str(), job.bytesToTarget, "B");
+        }
+        if (job.convergedRound > 0) {
+            std::string suffix = numJobs > 1 ? ":job" + std::to_string(job.jobId) : "";
+            recordScalar(("convergedRound" + suffix).c_str(), job.convergedRound);
+        }
+    }
+    if (totalRoundsCompleted > 0 && lastRoundCompletion > firstRoundStart) {
+        recordScalar("roundsPerSecond", totalRoundsCompleted / (lastRoundCompletion - firstRoundStart).dbl());
+    }
 }
@@ -2,16 +2,74 @@
 #define __BASESTATIONAPPFEDAVG_H
 
 #include <omnetpp.h>
+#include <set>
 #include "inet/applications/base/ApplicationBase.h"
 #include "inet/transportlayer/contract/udp/UdpSocket.h"
 #include "inet/common/lifecycle/LifecycleOperation.h"
 #include "inet/common/packet/Packet.h"
 #include "FederatedLearningModel.h"
+#include "FedAvgAggregator.h"
+#include "ServerOptimizer.h"
+#include "ValidationSet.h"
 #include "FedAvgMessage_m.h"
 
 using namespace omnetpp;
 using namespace inet;
 
+/**
+ * Ronde du mode pipeliné : agrégée dès le quorum, elle reste ouverte aux mises à jour
+ * des retardataires jusqu'à ce que tous les UAVs aient répondu
+ */
+struct PipelinedRound {
+    std::set<int> reporters;        // UAVs dont la mise à jour de cette ronde est reçue
+    std::vector<double> average;    // Moyenne des mises à jour intégrées, retardataires compris
+    int totalSamples = 0;           // Échantillons des mises à jour intégrées
+    bool aggregated = false;
+};
+
+/**
+ * État d'une tâche d'apprentissage fédéré ; la station de base multiplexe
+ * plusieurs tâches indépendantes sur la même flotte d'UAVs (identifiées par jobId)
+ */
+struct FedAvgJob {
+    int jobId = 0;
+    int currentRound = 0;
+    FederatedLearningModel globalModel;  // Modèle global
+    FedAvgAggregator aggregator;         // Modèles reçus des UAVs et échantillons par UAV
+    ServerOptimizer optimizer;           // Mise à jour du modèle global à partir de la moyenne
+    FedAvgAggregator consensusSamples;   // Derniers modèles échantillonnés par UAV (mode gossip)
+    cMessage *roundTimer = nullptr;      // Timer pour démarrer chaque ronde
+    simtime_t roundInterval;             // Intervalle entre les rondes (allongé à la convergence)
+    simtime_t roundDeadline;             // Échéance de la ronde en cours
+    int roundParticipants = 0;           // UAVs ayant reçu le modèle de la ronde en cours
+    bool roundAggregated = false;        // Ronde en cours déjà agrégée (mode non pipeliné)
+
+    // Versions du modèle global diffusé
+    int modelVersion = 0;                // Dernière version diffusée (0 : aucune)
+    std::vector<double> deliveredModel;  // Reconstruction de cette version détenue par les UAVs
+    std::map<int, int> uavVersions;      // Dernière version confirmée par UAV (via leurs mises à jour)
+    Packet *snapshotPacket = nullptr;    // Version actuelle complète, dupliquée pour chaque UAV
+    Packet *deltaPacket = nullptr;       // Delta de la version précédente à la version actuelle (nullptr : aucun)
+
+    // Mode pipeliné
+    std::map<int, PipelinedRound> pipeline; // Rondes agrégées encore ouvertes aux retardataires, par roundId
+    std::vector<double> lastAverage;     // Moyenne de la dernière agrégation
+
+    // Perte de la ronde, d'après la précision rapportée par les UAVs
+    double roundLossSum = 0;             // Somme des pertes pondérées par les échantillons
+    int roundLossSamples = 0;
+    int roundsToTarget = -1;             // Première ronde atteignant la perte visée
+    long bytesToTarget = -1;             // Octets FedAvg échangés jusqu'à cette ronde
+
+    // Évaluation du modèle global sur un jeu de validation et détection de la convergence
+    ValidationSet validationSet;
+    double bestLoss = -1;                // Meilleure perte de validation (négatif : aucune)
+    int roundsWithoutImprovement = 0;
+    int convergedRound = -1;             // Ronde à laquelle la convergence a été détectée
+
+    FedAvgJob() : globalModel(5, 0.01, 32, 3) {}
+};
+
 /**
  * Application de la station de base implémentant l'algorithme FedAvg
  */
@@ -22,24 +80,71 @@ class BaseStationAppFedAvg : public ApplicationBase, public UdpSocket::ICallback
     int numUavs = 0;           // Nombre total d'UAVs dans le réseau
     int fedAvgPort = 9000;     // Port dédié à la communication FedAvg
     int maxRounds = 10;        // Nombre maximal de cycles d'apprentissage fédéré
+    int fedAvgDscp = 46;       // Classe de trafic des modèles diffusés
+    int numJobs = 1;           // Nombre de tâches d'apprentissage multiplexées
+    simtime_t jobStagger;      // Décalage entre les rondes de deux tâches successives
+    bool deltaDownlink = false;      // Diffuser des deltas quantifiés aux UAVs à jour
+    double deltaQuantizationStep;    // Pas de quantification des deltas
+    bool pipelinedRounds = false;    // Ouvrir la ronde suivante dès le quorum, sans attendre les retardataires
+    int pipelineQuorum = 1;          // Mises à jour nécessaires à l'agrégation spéculative
+    int pipelineDepth = 2;           // Nombre maximal de rondes ouvertes simultanément
+    double stalenessDecay = 0.5;     // Atténuation d'une mise à jour tardive par ronde de retard
+    bool normalizedAggregation = false; // Normaliser les mises à jour par leur nombre de pas locaux (FedNova)
+    double targetLoss = -1;          // Perte visée pour roundsToTarget/bytesToTarget (négatif : non suivie)
+    int validationSamples = 0;       // Taille du jeu de validation de chaque tâche (0 : pas de validation)
+    double convergenceEpsilon = 0;   // Amélioration minimale de la perte de validation
+    int convergencePatience = 0;     // Rondes sans amélioration avant convergence (0 : jamais)
+    bool stretchOnConvergence = false; // Allonger l'intervalle des rondes au lieu d'arrêter
+    double roundIntervalStretch = 2; // Facteur d'allongement de l'intervalle
+    simtime_t maxRoundInterval;      // Intervalle maximal après allongement
+    bool acknowledgeUploads = false; // Acquitter les mises à jour locales, pour leur retransmission
+    bool gossipMode = false;   // Les UAVs moyennent entre eux ; la station de base ne fait qu'échantillonner
+    bool skipLowBattery = false;     // Exclure des rondes les UAVs sous minBatteryLevel
+    bool weightByBattery = false;    // Réduire le poids des mises à jour des UAVs sous minBatteryLevel
+    double minBatteryLevel = 0.1;    // Niveau de batterie en dessous duquel un UAV est ménagé
 
     // État
-    UdpSocket socket;
-    cMessage *roundTimer = nullptr;  // Timer pour démarrer chaque ronde
+    UdpSocket socket;                // Socket de télémétrie
+    UdpSocket fedAvgSocket;          // Socket dédié à la communication FedAvg
     simtime_t roundInterval;         // Intervalle entre les rondes
 
-    // État FedAvg
-    int currentRound = 0;
-    std::map<int, std::string> receivedModels;  // Modèles reçus des UAVs
-    std::map<int, int> samplesPerUav;           // Échantillons par UAV
-    FederatedLearningModel globalModel;         // Modèle global
+    // État FedAvg, par tâche (indexé par jobId)
+    std::vector<FedAvgJob> jobs;
 
     // Statistiques
     int numReceived = 0;
+    int totalRoundsCompleted = 0;     // Rondes agrégées, toutes tâches confondues
+    simtime_t firstRoundStart;
+    simtime_t lastRoundCompletion;
     std::map<L3Address, int> packetsPerUAV;
+    long telemetryBytesReceived = 0;  // Octets de télémétrie reçus (trames groupées et piggyback)
+    long fedAvgBytesReceived = 0;     // Octets FedAvg reçus
+    long fedAvgBytesSent = 0;         // Octets FedAvg envoyés (modèles globaux, accusés)
+    int telemetryReadingsReceived = 0;
+    int numSnapshotRequests = 0;
+    int numLateUpdatesFolded = 0;     // Mises à jour tardives intégrées (mode pipeliné)
+    int numStaleUpdatesDropped = 0;   // Mises à jour d'une ronde déjà fermée
+    int numLowBatterySkips = 0;       // Envois du modèle global omis pour batterie faible
+    std::map<int, double> uavBatteryLevels;   // Dernier niveau de batterie rapporté par UAV
+    std::map<int, double> uavEnergyConsumed;  // Dernière énergie consommée rapportée par UAV (J)
     static simsignal_t rcvdPkSignal;
     simsignal_t roundCompletedSignal;
     simsignal_t modelAccuracySignal;
+    simsignal_t telemetryDelaySignal;
+    simsignal_t modelUploadDelaySignal;
+    simsignal_t telemetryBytesSignal;
+    simsignal_t fedAvgBytesSignal;
+    simsignal_t consensusDistanceSignal;
+    simsignal_t downlinkDeltaBytesSignal;
+    simsignal_t downlinkFullBytesSignal;
+    simsignal_t roundLossSignal;
+    simsignal_t validationLossSignal;
+    simsignal_t validationMseSignal;
+    simsignal_t validationR2Signal;
+    simsignal_t convergedSignal;
+    simsignal_t lateUpdateStalenessSignal;
+    simsignal_t swarmEnergySignal;
+    simsignal_t qualityPerJouleSignal;
 
   protected:
     virtual void initialize(int stage) override;
@@ -47,12 +152,30 @@ class BaseStationAppFedAvg : public ApplicationBase, public UdpSocket::ICallback
     virtual void finish() override;
 
     // Méthodes FedAvg
-    virtual void startNextRound();
-    virtual void aggregateModels();
-    virtual void broadcastGlobalModel();
+    virtual void scheduleJobs();
+    virtual void startNextRound(FedAvgJob& job, const std::set<int> *recipients = nullptr);
+    virtual void aggregateModels(FedAvgJob& job);
+    virtual ValidationMetrics evaluateGlobalModel(FedAvgJob& job);
+    virtual void checkConvergence(FedAvgJob& job, double loss);
+    virtual void broadcastGlobalModel(FedAvgJob& job, const std::set<int> *recipients = nullptr);
+    virtual bool sendCurrentModel(FedAvgJob& job, int uavId, L3Address destAddr);
+    virtual std::string serializeDeliveredModel(const FedAvgJob& job);
+    virtual Packet *createGlobalModelPacket(FedAvgJob& job, int baseVersion, const std::string& weights);
+    virtual void sendGlobalModel(FedAvgJob& job, int uavId, L3Address destAddr, const Packet *model);
+    virtual void sendUploadAck(int jobId, int uavId, int roundId, L3Address destAddr);
+    virtual void tryAdvancePipeline(FedAvgJob& job);
+    virtual void processLateUpdate(FedAvgJob& job, const FedAvgMessage *msg, L3Address srcAddr);
+    virtual void handleRoundTimeout(FedAvgJob& job);
+    virtual void sampleConsensus(FedAvgJob& job, const FedAvgMessage *msg);
+
+    // Énergie des UAVs
+    virtual void updateUavEnergy(const FedAvgMessage *msg);
+    virtual int getParticipationSamples(const FedAvgMessage *msg) const;
+    virtual void emitEnergyEfficiency(double loss);
 
     // Méthodes d'application
     virtual void processPacket(Packet *pk);
+    virtual void processTelemetry(const Ptr<const Chunk>& data);
     virtual void processFedAvgMessage(FedAvgMessage *msg, L3Address srcAddr);
 
     // Méthodes du socket
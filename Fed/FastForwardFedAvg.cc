@@ -0,0 +1,237 @@
+#include "FastForwardFedAvg.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <thread>
+#include "FedAvgMessage_m.h"
+#include "SyntheticDataset.h"
+
+Define_Module(FastForwardFedAvg);
+
+FastForwardFedAvg::~FastForwardFedAvg() {
+    cancelAndDelete(roundTimer);
+}
+
+void FastForwardFedAvg::initialize() {
+    numUavs = par("numUavs");
+    maxRounds = par("maxRounds");
+    roundDeadline = par("roundDeadline");
+    targetLoss = par("targetLoss");
+    numThreads = par("numThreads");
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    roundCompletedSignal = registerSignal("roundCompleted");
+    roundDurationSignal = registerSignal("roundDuration");
+    participantsSignal = registerSignal("participants");
+    modelAccuracySignal = registerSignal("modelAccuracy");
+    globalLossSignal = registerSignal("globalLoss");
+
+    ServerOptimizer::Type optimizerType;
+    if (!ServerOptimizer::parseType(par("serverOptimizer").stdstringValue(), optimizerType))
+        throw cRuntimeError("Unknown server optimizer '%s'", par("serverOptimizer").stringValue());
+    optimizer = ServerOptimizer(optimizerType, par("serverLearningRate"), par("serverBeta1"),
+                                par("serverBeta2"), par("serverTau"));
+
+    linkModel.reset(createLinkModel());
+
+    // Créer les UAVs virtuels avec les mêmes données que les UAVs de la simulation complète
+    FederatedLearningModel prototype(5, par("learningRate"), par("batchSize"), par("numEpochs"));
+    prototype.seed(intuniform(0, INT_MAX));
+    uavModels.assign(numUavs, prototype);
+    uavData.clear();
+    for (int i = 0; i < numUavs; i++) {
+        uavData.push_back(generateSyntheticDataset(i));
+    }
+
+    // Poids initiaux tirés du générateur du module : deux exécutions de même graine sont identiques
+    globalModel.seed(intuniform(0, INT_MAX));
+    currentRound = 0;
+
+    WATCH(currentRound);
+    WATCH(bytesTransferred);
+    WATCH(updatesLost);
+
+    roundTimer = new cMessage("roundTimer");
+    scheduleAt(simTime(), roundTimer);
+
+    EV_INFO << "Fast-forward FedAvg initialized with " << numUavs << " virtual UAVs and "
+            << numThreads << " training threads." << endl;
+}
+
+ILinkModel *FastForwardFedAvg::createLinkModel() {
+    std::string type = par("linkModel").stdstringValue();
+    unsigned seed = getRNG(0)->intRand();
+
+    if (type == "ideal") {
+        return new IdealLinkModel();
+    }
+    else if (type == "fixedRate") {
+        return new FixedRateLinkModel(par("linkLatency").doubleValue(), par("linkBitrate").doubleValue(),
+                                      par("lossProbability").doubleValue(), seed);
+    }
+    else if (type == "heterogeneous") {
+        return new HeterogeneousLinkModel(par("linkLatency").doubleValue(), par("linkBitrate").doubleValue(),
+                                          par("lossProbability").doubleValue(), par("bitrateSigma").doubleValue(),
+                                          par("jitterMean").doubleValue(), seed);
+    }
+
+    throw cRuntimeError("Unknown link model '%s'", type.c_str());
+}
+
+void FastForwardFedAvg::handleMessage(cMessage *msg) {
+    if (msg == roundTimer) {
+        runRound();
+    }
+}
+
+void FastForwardFedAvg::runRound() {
+    currentRound++;
+
+    if (currentRound > maxRounds) {
+        EV_INFO << "Fast-forward federated learning completed after " << (currentRound-1) << " rounds." << endl;
+        return;
+    }
+
+    aggregator.clear();
+
+    // Phase descendante : diffuser le modèle global sérialisé, comme la station de base
+    std::string globalWeights = globalModel.serialize();
+    long downlinkBytes = inet::FEDAVG_HEADER_LENGTH.get() + globalWeights.size();
+
+    // Un seul exemplaire décodé, partagé par les UAVs jusqu'à leur premier entraînement
+    std::vector<double> decodedWeights;
+    FederatedLearningModel::parseWeights(globalWeights, decodedWeights);
+    auto globalSnapshot = std::make_shared<const std::vector<double>>(std::move(decodedWeights));
+
+    std::vector<int> participants;
+    std::vector<double> downlinkDelay(numUavs, 0.0);
+    for (int i = 0; i < numUavs; i++) {
+        LinkTransfer transfer = linkModel->transfer(i, downlinkBytes);
+        bytesTransferred += downlinkBytes;
+
+        if (transfer.delivered && transfer.delay < roundDeadline.dbl()) {
+            uavModels[i].shareWeights(globalSnapshot);
+            downlinkDelay[i] = transfer.delay;
+            participants.push_back(i);
+        }
+    }
+
+    // Entraînement local des UAVs ayant reçu le modèle
+    std::vector<double> accuracies(participants.size(), 0.0);
+    trainInParallel(participants, accuracies);
+
+    // Phase montante : seules les mises à jour arrivées avant l'échéance sont agrégées
+    double roundDuration = 0.0;
+    double accuracySum = 0.0;
+    bool missedDeadline = participants.size() < static_cast<size_t>(numUavs);
+
+    for (size_t k = 0; k < participants.size(); k++) {
+        int i = participants[k];
+        std::string localWeights = uavModels[i].serialize();
+        long uplinkBytes = inet::FEDAVG_HEADER_LENGTH.get() + localWeights.size();
+
+        LinkTransfer transfer = linkModel->transfer(i, uplinkBytes);
+        bytesTransferred += uplinkBytes;
+        double arrival = downlinkDelay[i] + transfer.delay;
+
+        if (!transfer.delivered || arrival > roundDeadline.dbl()) {
+            updatesLost++;
+            missedDeadline = true;
+            continue;
+        }
+
+        aggregator.addSerializedModel(i, localWeights, uavData[i].size());
+        roundDuration = std::max(roundDuration, arrival);
+        accuracySum += accuracies[k];
+    }
+
+    // La station de base attend l'échéance si une mise à jour manque
+    if (missedDeadline) {
+        roundDuration = roundDeadline.dbl();
+    }
+
+    std::vector<double> aggregatedWeights = aggregator.aggregate();
+    if (!aggregatedWeights.empty()) {
+        // La moyenne moins le modèle global sert de pseudo-gradient à l'optimiseur du serveur
+        std::vector<double> weights = globalModel.getWeights();
+        optimizer.step(weights, aggregatedWeights);
+        globalModel.setWeights(weights);
+        emit(modelAccuracySignal, accuracySum / aggregator.size());
+    }
+    else {
+        EV_WARN << "No models received for aggregation in round " << currentRound << endl;
+    }
+
+    double loss = evaluateGlobalLoss();
+    emit(globalLossSignal, loss);
+    if (targetLoss >= 0 && roundsToTarget < 0 && loss <= targetLoss) {
+        roundsToTarget = currentRound;
+        bytesToTarget = bytesTransferred;
+    }
+
+    emit(participantsSignal, aggregator.size());
+    emit(roundDurationSignal, roundDuration);
+    emit(roundCompletedSignal, currentRound);
+
+    scheduleAt(simTime() + roundDuration, roundTimer);
+}
+
+double FastForwardFedAvg::evaluateGlobalLoss() {
+    // Erreur absolue moyenne du modèle global sur l'ensemble des données des UAVs
+    double errorSum = 0.0;
+    size_t samples = 0;
+    for (const auto& data : uavData) {
+        if (data.empty())
+            continue;
+        errorSum += (1.0 / globalModel.evaluate(data) - 1.0) * data.size();
+        samples += data.size();
+    }
+    return samples > 0 ? errorSum / samples : 0.0;
+}
+
+void FastForwardFedAvg::trainInParallel(const std::vector<int>& participants, std::vector<double>& accuracies) {
+    // Chaque UAV virtuel a son propre modèle et ses propres données : aucun partage entre threads
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t k;
+        while ((k = next++) < participants.size()) {
+            int i = participants[k];
+            uavModels[i].train(uavData[i]);
+            accuracies[k] = uavModels[i].evaluate(uavData[i]);
+        }
+    };
+
+    int threads = std::min<int>(numThreads, participants.size());
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+void FastForwardFedAvg::finish() {
+    // Précision finale du modèle global sur l'ensemble des données des UAVs
+    double accuracySum = 0.0;
+    for (int i = 0; i < numUavs; i++) {
+        accuracySum += globalModel.evaluate(uavData[i]);
+    }
+
+    recordScalar("roundsCompleted", std::min(currentRound, maxRounds));
+    recordScalar("bytesTransferred", bytesTransferred, "B");
+    recordScalar("updatesLost", updatesLost);
+    if (roundsToTarget > 0) {
+        recordScalar("roundsToTarget", roundsToTarget);
+        recordScalar("bytesToTarget", bytesToTarget, "B");
+    }
+    if (numUavs > 0) {
+        recordScalar("finalAccuracy", accuracySum / numUavs);
+    }
+
+    EV_INFO << "Fast-forward FedAvg finished after " << std::min(currentRound, maxRounds) << " rounds, "
+            << bytesTransferred << " bytes transferred." << endl;
+}
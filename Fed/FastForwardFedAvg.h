@@ -0,0 +1,67 @@
+#ifndef __FASTFORWARDFEDAVG_H
+#define __FASTFORWARDFEDAVG_H
+
+#include <omnetpp.h>
+#include <memory>
+#include "FederatedLearningModel.h"
+#include "FedAvgAggregator.h"
+#include "ServerOptimizer.h"
+#include "LinkModel.h"
+
+using namespace omnetpp;
+
+/**
+ * Mode FedAvg « sans réseau » : exécute l'entraînement local de N UAVs virtuels
+ * et l'agrégation de la station de base dans un seul module, sans pile INET.
+ * Les échanges sont remplacés par un modèle de latence/pertes (ILinkModel) et
+ * l'entraînement des UAVs d'une ronde est réparti sur plusieurs cœurs.
+ * Destiné aux balayages de paramètres ; les configurations intéressantes sont
+ * ensuite confirmées en simulation complète (UAVNetwork).
+ */
+class FastForwardFedAvg : public cSimpleModule {
+  protected:
+    // Configuration
+    int numUavs = 0;
+    int maxRounds = 10;
+    simtime_t roundDeadline;   // Délai maximal d'une ronde ; les mises à jour plus tardives sont ignorées
+    int numThreads = 1;        // Threads d'entraînement
+    double targetLoss = -1;    // Perte visée pour roundsToTarget/bytesToTarget (négatif : non suivie)
+
+    // État
+    cMessage *roundTimer = nullptr;
+    int currentRound = 0;
+    FederatedLearningModel globalModel;
+    FedAvgAggregator aggregator;
+    ServerOptimizer optimizer;
+    std::unique_ptr<ILinkModel> linkModel;
+
+    // UAVs virtuels
+    std::vector<FederatedLearningModel> uavModels;
+    std::vector<std::vector<std::pair<std::vector<double>, double>>> uavData;
+
+    // Statistiques
+    long bytesTransferred = 0;
+    int updatesLost = 0;
+    int roundsToTarget = -1;
+    long bytesToTarget = -1;
+    simsignal_t roundCompletedSignal;
+    simsignal_t roundDurationSignal;
+    simsignal_t participantsSignal;
+    simsignal_t modelAccuracySignal;
+    simsignal_t globalLossSignal;
+
+  protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual ILinkModel *createLinkModel();
+    virtual void runRound();
+    virtual double evaluateGlobalLoss();
+    virtual void trainInParallel(const std::vector<int>& participants, std::vector<double>& accuracies);
+
+  public:
+    virtual ~FastForwardFedAvg();
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef __FEDAVGAGGREGATOR_H
+#define __FEDAVGAGGREGATOR_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include "FederatedLearningModel.h"
+
+/**
+ * Agrégateur FedAvg : collecte les modèles locaux d'une ronde et calcule
+ * leur moyenne pondérée par le nombre d'échantillons.
+ * Partagé par la station de base et le mode sans réseau (FastForwardFedAvg)
+ * pour que les deux appliquent exactement la même règle d'agrégation.
+ */
+class FedAvgAggregator {
+protected:
+    // Poids reçus par UAV
+    std::map<int, std::vector<double>> models;
+
+    // Échantillons par UAV
+    std::map<int, int> samplesPerUav;
+
+    // Pas de gradient locaux par UAV (0 si inconnu)
+    std::map<int, int> stepsPerUav;
+
+public:
+    /**
+     * Réinitialise l'agrégateur pour une nouvelle ronde
+     */
+    void clear() {
+        models.clear();
+        samplesPerUav.clear();
+        stepsPerUav.clear();
+    }
+
+    /**
+     * Ajoute le modèle d'un UAV (remplace un éventuel envoi précédent)
+     * @param uavId Identifiant de l'UAV
+     * @param weights Poids du modèle local
+     * @param samples Nombre d'échantillons utilisés pour l'entraînement
+     * @param localSteps Pas de gradient effectués (0 si inconnu)
+     */
+    void addModel(int uavId, const std::vector<double>& weights, int samples, int localSteps = 0) {
+        models[uavId] = weights;
+        samplesPerUav[uavId] = samples;
+        stepsPerUav[uavId] = localSteps;
+    }
+
+    /**
+     * Ajoute le modèle sérialisé d'un UAV
+     * @param uavId Identifiant de l'UAV
+     * @param serialized Poids sérialisés
+     * @param samples Nombre d'échantillons utilisés pour l'entraînement
+     * @param localSteps Pas de gradient effectués (0 si inconnu)
+     * @return true si la désérialisation a réussi
+     */
+    bool addSerializedModel(int uavId, const std::string& serialized, int samples, int localSteps = 0) {
+        FederatedLearningModel uavModel;
+        if (!uavModel.deserialize(serialized)) {
+            return false;
+        }
+        addModel(uavId, uavModel.getWeights(), samples, localSteps);
+        return true;
+    }
+
+    /**
+     * @return Nombre de modèles collectés
+     */
+    int size() const {
+        return models.size();
+    }
+
+    bool empty() const {
+        return models.empty();
+    }
+
+    bool contains(int uavId) const {
+        return models.count(uavId) > 0;
+    }
+
+    /**
+     * @return Nombre total d'échantillons des modèles collectés
+     */
+    int getTotalSamples() const {
+        int totalSamples = 0;
+        for (const auto& entry : samplesPerUav) {
+            totalSamples += entry.second;
+        }
+        return totalSamples;
+    }
+
+    /**
+     * Calcule la moyenne des modèles pondérée par le nombre d'échantillons
+     * @return Poids agrégés (vide si aucun modèle ou aucun échantillon)
+     */
+    std::vector<double> aggregate() const {
+        int totalSamples = getTotalSamples();
+        if (models.empty() || totalSamples == 0) {
+            return std::vector<double>();
+        }
+
+        std::vector<double> aggregatedWeights(models.begin()->second.size(), 0.0);
+
+        for (const auto& entry : models) {
+            // Pondérer par le nombre d'échantillons
+            double weight = static_cast<double>(samplesPerUav.at(entry.first)) / totalSamples;
+            const auto& uavWeights = entry.second;
+
+            for (size_t i = 0; i < aggregatedWeights.size(); i++) {
+                aggregatedWeights[i] += uavWeights[i] * weight;
+            }
+        }
+
+        return aggregatedWeights;
+    }
+
+    /**
+     * Agrégation normalisée (FedNova) : chaque mise à jour est divisée par son nombre de pas
+     * locaux avant la moyenne, puis remise à l'échelle du nombre moyen de pas. Les UAVs qui
+     * ont fait plus de pas ne tirent plus le modèle global vers leur optimum local ;
+     * à nombre de pas égal, le résultat est la moyenne de aggregate().
+     * @param reference Modèle global à partir duquel les UAVs se sont entraînés
+     * @return Poids agrégés (vide si aucun modèle ou aucun échantillon ; aggregate() si un nombre de pas manque)
+     */
+    std::vector<double> aggregateNormalized(const std::vector<double>& reference) const {
+        int totalSamples = getTotalSamples();
+        if (models.empty() || totalSamples == 0) {
+            return std::vector<double>();
+        }
+        for (const auto& entry : stepsPerUav) {
+            if (entry.second <= 0) {
+                return aggregate();
+            }
+        }
+
+        // Direction moyenne par pas, et nombre effectif de pas pondéré par les échantillons
+        std::vector<double> direction(reference.size(), 0.0);
+        double effectiveSteps = 0.0;
+        for (const auto& entry : models) {
+            double weight = static_cast<double>(samplesPerUav.at(entry.first)) / totalSamples;
+            int steps = stepsPerUav.at(entry.first);
+            const auto& uavWeights = entry.second;
+
+            for (size_t i = 0; i < direction.size(); i++) {
+                direction[i] += weight * (uavWeights[i] - reference[i]) / steps;
+            }
+            effectiveSteps += weight * steps;
+        }
+
+        std::vector<double> aggregatedWeights(reference);
+        for (size_t i = 0; i < aggregatedWeights.size(); i++) {
+            aggregatedWeights[i] += effectiveSteps * direction[i];
+        }
+        return aggregatedWeights;
+    }
+
+    /**
+     * Distance euclidienne moyenne des modèles collectés à un modèle de référence
+     * (écart au consensus en mode gossip)
+     * @param reference Poids de référence
+     * @return Distance moyenne (0 si aucun modèle)
+     */
+    double meanDistanceTo(const std::vector<double>& reference) const {
+        if (models.empty()) {
+            return 0.0;
+        }
+
+        double totalDistance = 0.0;
+        for (const auto& entry : models) {
+            double squared = 0.0;
+            for (size_t i = 0; i < reference.size(); i++) {
+                double diff = entry.second[i] - reference[i];
+                squared += diff * diff;
+            }
+            totalDistance += std::sqrt(squared);
+        }
+        return totalDistance / models.size();
+    }
+};
+
+#endif
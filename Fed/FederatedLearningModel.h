@@ -7,6 +7,16 @@
 #include <cmath>
 #include <random>
 #include <memory>
+#include <sstream>
+
+/**
+ * Métriques d'un modèle sur un ensemble de données
+ */
+struct ModelMetrics {
+    double mae = 0.0;       // Erreur absolue moyenne
+    double mse = 0.0;       // Erreur quadratique moyenne
+    double accuracy = 0.0;  // Précision 1/(1+MAE)
+};
 
 /**
  * Classe représentant un modèle d'apprentissage fédéré simple.
@@ -15,9 +25,27 @@
  */
 class FederatedLearningModel {
 protected:
-    // Paramètres du modèle (poids)
+    // Paramètres du modèle (poids) ; tampon privé, vide tant que le modèle partage un instantané
     std::vector<double> weights;
 
+    // Instantané immuable partagé avec d'autres modèles (copie à l'écriture)
+    std::shared_ptr<const std::vector<double>> sharedWeights;
+
+    // Révision des poids, incrémentée à chaque modification
+    unsigned long revision = 0;
+
+    // Métriques de la dernière évaluation, valides pour une révision des poids et une génération des données
+    ModelMetrics cachedMetrics;
+    bool hasCachedMetrics = false;
+    unsigned long cachedRevision = 0;
+    unsigned long cachedDataGeneration = 0;
+
+    // Métriques de la dernière époque de l'entraînement (erreurs de chaque lot avant sa mise à jour),
+    // valides tant que les poids restent ceux de la révision lastPassRevision
+    ModelMetrics lastPassMetrics;
+    bool hasLastPass = false;
+    unsigned long lastPassRevision = 0;
+
     // Dimensions du modèle
     int inputDimension;
 
@@ -42,16 +70,27 @@ public:
         learningRate(lr),
         batchSize(bSize),
         numEpochs(epochs),
-        rng(std::random_device()()) {
+        rng(std::mt19937::default_seed) {
 
         // Initialiser les poids aléatoirement
         initializeWeights();
     }
 
+    /**
+     * Réinitialise le générateur et les poids du modèle, pour des exécutions reproductibles
+     * @param value Graine, tirée du générateur de nombres aléatoires du module
+     */
+    void seed(unsigned int value) {
+        rng.seed(value);
+        initializeWeights();
+    }
+
     /**
      * Initialise les poids du modèle avec de petites valeurs aléatoires
      */
     void initializeWeights() {
+        sharedWeights.reset();
+        revision++;
         weights.resize(inputDimension + 1); // +1 pour le biais
         std::uniform_real_distribution<double> dist(-0.1, 0.1);
 
@@ -70,9 +109,10 @@ public:
             throw std::runtime_error("Dimension d'entrée incorrecte");
         }
 
-        double result = weights[0]; // Biais
+        const std::vector<double>& w = currentWeights();
+        double result = w[0]; // Biais
         for (int i = 0; i < inputDimension; i++) {
-            result += inputs[i] * weights[i + 1];
+            result += inputs[i] * w[i + 1];
         }
 
         return result;
@@ -83,55 +123,198 @@ public:
      * @param data Ensemble de données (inputs, output)
      */
     void train(const std::vector<std::pair<std::vector<double>, double>>& data) {
-        if (data.empty()) return;
+        trainSteps(data, numEpochs * getNumBatches(data.size()));
+    }
 
-        for (int epoch = 0; epoch < numEpochs; epoch++) {
-            // Parcourir les données par lots
-            for (int i = 0; i < data.size(); i += batchSize) {
-                int batchEnd = std::min((int)data.size(), i + batchSize);
+    /**
+     * Entraîne le modèle pendant un nombre donné de pas de gradient (un pas par lot),
+     * en parcourant les lots cycliquement ; train() correspond à numEpochs passes complètes.
+     * Si l'entraînement comporte au moins une passe complète, les erreurs calculées pour le
+     * gradient pendant la dernière époque donnent les métriques du modèle entraîné (getLastPassMetrics)
+     * sans passe supplémentaire ; chaque lot étant mesuré avant sa mise à jour, ce ne sont pas
+     * les métriques exactes des poids obtenus (voir getMetrics).
+     * @param data Ensemble de données (inputs, output)
+     * @param steps Nombre de pas de gradient
+     */
+    void trainSteps(const std::vector<std::pair<std::vector<double>, double>>& data, int steps) {
+        if (data.empty() || steps <= 0) return;
 
-                // Calculer les gradients pour ce lot
-                std::vector<double> gradients(weights.size(), 0.0);
+        // Première écriture : le modèle obtient son propre tampon
+        materialize();
 
-                for (int j = i; j < batchEnd; j++) {
-                    const auto& sample = data[j];
-                    const auto& inputs = sample.first;
-                    double target = sample.second;
+        int numBatches = getNumBatches(data.size());
+        int metricsStart = steps >= numBatches ? steps - numBatches : steps;
+        double absoluteSum = 0.0;
+        double squaredSum = 0.0;
 
-                    // Prédiction
-                    double prediction = predict(inputs);
+        for (int step = 0; step < steps; step++) {
+            // Parcourir les données par lots
+            int i = (step % numBatches) * batchSize;
+            int batchEnd = std::min((int)data.size(), i + batchSize);
 
-                    // Erreur
-                    double error = prediction - target;
+            // Calculer les gradients pour ce lot
+            std::vector<double> gradients(weights.size(), 0.0);
 
-                    // Mettre à jour le gradient du biais
-                    gradients[0] += error;
+            for (int j = i; j < batchEnd; j++) {
+                const auto& sample = data[j];
+                const auto& inputs = sample.first;
+                double target = sample.second;
 
-                    // Mettre à jour les gradients des poids
-                    for (int k = 0; k < inputDimension; k++) {
-                        gradients[k + 1] += error * inputs[k];
-                    }
-                }
+                // Prédiction
+                double prediction = predict(inputs);
 
-                // Normaliser les gradients par la taille du lot
-                for (auto& grad : gradients) {
-                    grad /= (batchEnd - i);
+                // Erreur
+                double error = prediction - target;
+                if (step >= metricsStart) {
+                    absoluteSum += std::abs(error);
+                    squaredSum += error * error;
                 }
 
-                // Mettre à jour les poids
-                for (int w = 0; w < weights.size(); w++) {
-                    weights[w] -= learningRate * gradients[w];
+                // Mettre à jour le gradient du biais
+                gradients[0] += error;
+
+                // Mettre à jour les gradients des poids
+                for (int k = 0; k < inputDimension; k++) {
+                    gradients[k + 1] += error * inputs[k];
                 }
             }
+
+            // Normaliser les gradients par la taille du lot
+            for (auto& grad : gradients) {
+                grad /= (batchEnd - i);
+            }
+
+            // Mettre à jour les poids
+            for (int w = 0; w < weights.size(); w++) {
+                weights[w] -= learningRate * gradients[w];
+            }
+        }
+
+        revision++;
+        hasLastPass = metricsStart < steps;
+        lastPassRevision = revision;
+        if (hasLastPass) {
+            lastPassMetrics = makeMetrics(absoluteSum / data.size(), squaredSum / data.size());
         }
     }
 
+    /**
+     * @return true si le dernier entraînement a couvert une époque complète
+     *         et que les poids n'ont pas changé depuis
+     */
+    bool hasLastPassMetrics() const {
+        return hasLastPass && lastPassRevision == revision;
+    }
+
+    /**
+     * @return Métriques mesurées pendant la dernière époque du dernier entraînement
+     *         (à n'utiliser que si hasLastPassMetrics())
+     */
+    const ModelMetrics& getLastPassMetrics() const {
+        return lastPassMetrics;
+    }
+
+    /**
+     * @param numSamples Nombre d'échantillons
+     * @return Nombre de lots d'une passe complète sur les données
+     */
+    int getNumBatches(size_t numSamples) const {
+        return (numSamples + batchSize - 1) / batchSize;
+    }
+
+    /**
+     * @param numSamples Nombre d'échantillons
+     * @return Nombre de pas de gradient d'un entraînement complet (numEpochs passes)
+     */
+    int getDefaultSteps(size_t numSamples) const {
+        return numEpochs * getNumBatches(numSamples);
+    }
+
+    /**
+     * Estime le nombre d'opérations flottantes d'un entraînement
+     * (prédiction, erreur et gradient par échantillon ; normalisation et mise à jour par lot)
+     * @param numSamples Nombre d'échantillons des données locales
+     * @param steps Nombre de pas de gradient
+     * @return FLOPs estimés
+     */
+    double estimateTrainingFlops(size_t numSamples, int steps) const {
+        if (numSamples == 0 || steps <= 0) return 0.0;
+
+        double samplesPerBatch = static_cast<double>(numSamples) / getNumBatches(numSamples);
+        double flopsPerSample = 2.0 * inputDimension + 1   // Prédiction
+                              + 1                          // Erreur
+                              + 2.0 * inputDimension + 1;  // Gradient
+        double flopsPerBatch = 3.0 * (inputDimension + 1);  // Normalisation et mise à jour
+        return steps * (samplesPerBatch * flopsPerSample + flopsPerBatch);
+    }
+
+    /**
+     * Évalue le modèle sur un ensemble de données
+     * @param data Ensemble de données (inputs, output)
+     * @return Précision 1/(1+MAE), où MAE est l'erreur absolue moyenne
+     */
+    double evaluate(const std::vector<std::pair<std::vector<double>, double>>& data) {
+        return getMetrics(data).accuracy;
+    }
+
+    /**
+     * Évalue le modèle sur un ensemble de données versionné, avec cache
+     * @param data Ensemble de données (inputs, output)
+     * @param dataGeneration Génération des données, à changer par l'appelant à chaque modification
+     * @return Précision 1/(1+MAE)
+     */
+    double evaluate(const std::vector<std::pair<std::vector<double>, double>>& data, unsigned long dataGeneration) {
+        return getMetrics(data, dataGeneration).accuracy;
+    }
+
+    /**
+     * Métriques exactes des poids actuels sur un ensemble de données (une passe complète)
+     * @param data Ensemble de données (inputs, output)
+     * @return MAE, MSE et précision
+     */
+    ModelMetrics getMetrics(const std::vector<std::pair<std::vector<double>, double>>& data) {
+        if (data.empty()) return ModelMetrics();
+
+        double absoluteSum = 0.0;
+        double squaredSum = 0.0;
+        for (const auto& sample : data) {
+            double error = predict(sample.first) - sample.second;
+            absoluteSum += std::abs(error);
+            squaredSum += error * error;
+        }
+        return makeMetrics(absoluteSum / data.size(), squaredSum / data.size());
+    }
+
+    /**
+     * Métriques exactes des poids actuels, calculées une seule fois par révision des poids
+     * et génération des données ; les appels suivants sont servis par le cache
+     * @param data Ensemble de données (inputs, output)
+     * @param dataGeneration Génération des données, à changer par l'appelant à chaque modification
+     * @return MAE, MSE et précision
+     */
+    ModelMetrics getMetrics(const std::vector<std::pair<std::vector<double>, double>>& data, unsigned long dataGeneration) {
+        if (!hasCachedMetrics || cachedRevision != revision || cachedDataGeneration != dataGeneration) {
+            cachedMetrics = getMetrics(data);
+            cachedRevision = revision;
+            cachedDataGeneration = dataGeneration;
+            hasCachedMetrics = true;
+        }
+        return cachedMetrics;
+    }
+
+    /**
+     * @return Révision des poids, incrémentée à chaque modification
+     */
+    unsigned long getRevision() const {
+        return revision;
+    }
+
     /**
      * Retourne les poids actuels du modèle
      * @return Vecteur de poids
      */
     const std::vector<double>& getWeights() const {
-        return weights;
+        return currentWeights();
     }
 
     /**
@@ -139,10 +322,40 @@ public:
      * @param newWeights Nouveaux poids à définir
      */
     void setWeights(const std::vector<double>& newWeights) {
-        if (newWeights.size() != weights.size()) {
+        if (newWeights.size() != currentWeights().size()) {
             throw std::runtime_error("Dimension des poids incorrecte");
         }
+        sharedWeights.reset();
         weights = newWeights;
+        revision++;
+    }
+
+    /**
+     * Partage un instantané immuable au lieu d'en garder une copie ;
+     * le tampon privé n'est recréé qu'à la première écriture (train)
+     * @param snapshot Poids partagés
+     */
+    void shareWeights(const std::shared_ptr<const std::vector<double>>& snapshot) {
+        if (snapshot == nullptr || snapshot->size() != currentWeights().size()) {
+            throw std::runtime_error("Dimension des poids incorrecte");
+        }
+        sharedWeights = snapshot;
+        std::vector<double>().swap(weights);
+        revision++;
+    }
+
+    /**
+     * @return true si le modèle lit un instantané partagé
+     */
+    bool isShared() const {
+        return sharedWeights != nullptr;
+    }
+
+    /**
+     * @return Octets alloués en propre par le modèle pour ses poids
+     */
+    size_t getPrivateBytes() const {
+        return weights.capacity() * sizeof(double);
     }
 
     /**
@@ -151,7 +364,7 @@ public:
      */
     std::string serialize() const {
         std::string result;
-        for (const auto& w : weights) {
+        for (const auto& w : currentWeights()) {
             if (!result.empty()) result += ";";
             result += std::to_string(w);
         }
@@ -165,9 +378,27 @@ public:
      */
     bool deserialize(const std::string& serialized) {
         std::vector<double> newWeights;
+        if (!parseWeights(serialized, newWeights) || newWeights.size() != currentWeights().size()) {
+            return false;
+        }
+
+        sharedWeights.reset();
+        weights = std::move(newWeights);
+        revision++;
+        return true;
+    }
+
+    /**
+     * Décode des poids sérialisés sans les affecter à un modèle
+     * @param serialized Chaîne sérialisée
+     * @param newWeights Poids décodés
+     * @return true si le décodage a réussi
+     */
+    static bool parseWeights(const std::string& serialized, std::vector<double>& newWeights) {
         std::string token;
         std::istringstream tokenStream(serialized);
 
+        newWeights.clear();
         while (std::getline(tokenStream, token, ';')) {
             try {
                 newWeights.push_back(std::stod(token));
@@ -175,13 +406,33 @@ public:
                 return false;
             }
         }
+        return true;
+    }
 
-        if (newWeights.size() == weights.size()) {
-            weights = newWeights;
-            return true;
-        }
+protected:
+    /**
+     * @return Poids lus par le modèle : l'instantané partagé s'il existe, sinon le tampon privé
+     */
+    const std::vector<double>& currentWeights() const {
+        return sharedWeights ? *sharedWeights : weights;
+    }
+
+    static ModelMetrics makeMetrics(double mae, double mse) {
+        ModelMetrics metrics;
+        metrics.mae = mae;
+        metrics.mse = mse;
+        metrics.accuracy = 1.0 / (1.0 + mae); // Convertir l'erreur en une mesure de "précision"
+        return metrics;
+    }
 
-        return false;
+    /**
+     * Remplace l'instantané partagé par une copie privée avant une écriture
+     */
+    void materialize() {
+        if (sharedWeights) {
+            weights = *sharedWeights;
+            sharedWeights.reset();
+        }
     }
 };
 
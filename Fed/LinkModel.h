@@ -0,0 +1,98 @@
+#ifndef __LINKMODEL_H
+#define __LINKMODEL_H
+
+#include <map>
+#include <cmath>
+#include <random>
+
+/**
+ * Résultat d'un transfert simulé entre un UAV et la station de base
+ */
+struct LinkTransfer {
+    bool delivered;  // Le message est arrivé
+    double delay;    // Délai de bout en bout (s)
+};
+
+/**
+ * Modèle de latence et de pertes utilisé à la place de la pile INET
+ * dans le mode sans réseau (FastForwardFedAvg)
+ */
+class ILinkModel {
+public:
+    virtual ~ILinkModel() {}
+
+    /**
+     * Simule le transfert d'un message
+     * @param uavId UAV émetteur ou destinataire
+     * @param bytes Taille du message en octets
+     * @return Résultat du transfert
+     */
+    virtual LinkTransfer transfer(int uavId, long bytes) = 0;
+};
+
+/**
+ * Lien idéal : aucun délai, aucune perte
+ */
+class IdealLinkModel : public ILinkModel {
+public:
+    virtual LinkTransfer transfer(int uavId, long bytes) override {
+        return {true, 0.0};
+    }
+};
+
+/**
+ * Lien à débit fixe : latence + temps de sérialisation, pertes de Bernoulli
+ */
+class FixedRateLinkModel : public ILinkModel {
+protected:
+    double latency;          // Latence de propagation et d'accès (s)
+    double bitrate;          // Débit du lien (bit/s)
+    double lossProbability;  // Probabilité de perte d'un message
+    std::mt19937 rng;
+
+public:
+    FixedRateLinkModel(double latency, double bitrate, double lossProbability, unsigned seed) :
+        latency(latency),
+        bitrate(bitrate),
+        lossProbability(lossProbability),
+        rng(seed) {
+    }
+
+    virtual LinkTransfer transfer(int uavId, long bytes) override {
+        std::bernoulli_distribution loss(lossProbability);
+        return {!loss(rng), latency + bytes * 8.0 / bitrate};
+    }
+};
+
+/**
+ * Lien hétérogène : chaque UAV a son propre débit, tiré une fois selon une loi
+ * log-normale centrée sur le débit nominal, et chaque transfert subit une gigue exponentielle
+ */
+class HeterogeneousLinkModel : public FixedRateLinkModel {
+protected:
+    double bitrateSigma;               // Écart-type du log du débit
+    double jitterMean;                 // Gigue moyenne par transfert (s)
+    std::map<int, double> uavBitrate;  // Débit tiré pour chaque UAV
+
+public:
+    HeterogeneousLinkModel(double latency, double bitrate, double lossProbability,
+                           double bitrateSigma, double jitterMean, unsigned seed) :
+        FixedRateLinkModel(latency, bitrate, lossProbability, seed),
+        bitrateSigma(bitrateSigma),
+        jitterMean(jitterMean) {
+    }
+
+    virtual LinkTransfer transfer(int uavId, long bytes) override {
+        auto it = uavBitrate.find(uavId);
+        if (it == uavBitrate.end()) {
+            std::lognormal_distribution<double> rateDist(std::log(bitrate), bitrateSigma);
+            it = uavBitrate.emplace(uavId, rateDist(rng)).first;
+        }
+
+        std::bernoulli_distribution loss(lossProbability);
+        double jitter = jitterMean > 0 ? std::exponential_distribution<double>(1.0 / jitterMean)(rng) : 0.0;
+        return {!loss(rng), latency + bytes * 8.0 / it->second + jitter};
+    }
+};
+
+#endif
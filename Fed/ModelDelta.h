@@ -0,0 +1,84 @@
+#ifndef __MODELDELTA_H
+#define __MODELDELTA_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cmath>
+
+/**
+ * Arrondit un poids à la précision de la sérialisation des modèles (std::to_string).
+ * Les deux extrémités d'un delta arrondissent la référence de la même façon : un UAV qui
+ * suit les deltas détient alors exactement les poids d'un instantané complet de la même version.
+ * @param value Poids
+ * @return Poids tel qu'il est relu après sérialisation
+ */
+inline double roundToSerializedPrecision(double value)
+{
+    return std::stod(std::to_string(value));
+}
+
+/**
+ * Encode la différence entre le nouveau modèle global et la version détenue par les UAVs.
+ * Chaque composante est quantifiée au pas donné et seules les composantes non nulles
+ * après quantification sont transmises (format "indice:valeur;...").
+ * La référence avance de la différence effectivement transmise, arrondie comme un
+ * instantané sérialisé : l'erreur de quantification est reportée sur le delta suivant
+ * au lieu de s'accumuler chez les UAVs.
+ * @param target Poids du nouveau modèle global
+ * @param reference Reconstruction détenue par les UAVs, mise à jour en place
+ * @param step Pas de quantification
+ * @return Delta sérialisé (vide si aucune composante ne change)
+ */
+inline std::string encodeModelDelta(const std::vector<double>& target, std::vector<double>& reference, double step)
+{
+    std::string result;
+    for (size_t i = 0; i < target.size(); i++) {
+        long long quantized = std::llround((target[i] - reference[i]) / step);
+        if (quantized == 0) {
+            continue;
+        }
+        reference[i] = roundToSerializedPrecision(reference[i] + quantized * step);
+
+        if (!result.empty()) result += ";";
+        result += std::to_string(i) + ":" + std::to_string(quantized);
+    }
+    return result;
+}
+
+/**
+ * Applique en place un delta produit par encodeModelDelta, avec le même arrondi de la référence
+ * @param delta Delta sérialisé
+ * @param weights Poids de la version de référence, mis à jour en place
+ * @param step Pas de quantification utilisé à l'encodage
+ * @return true si le delta est valide (les poids ne sont pas modifiés sinon)
+ */
+inline bool applyModelDelta(const std::string& delta, std::vector<double>& weights, double step)
+{
+    std::vector<std::pair<size_t, long long>> entries;
+    std::string token;
+    std::istringstream tokenStream(delta);
+
+    while (std::getline(tokenStream, token, ';')) {
+        size_t separator = token.find(':');
+        if (separator == std::string::npos) {
+            return false;
+        }
+        try {
+            size_t index = std::stoul(token.substr(0, separator));
+            if (index >= weights.size()) {
+                return false;
+            }
+            entries.emplace_back(index, std::stoll(token.substr(separator + 1)));
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+
+    for (const auto& entry : entries) {
+        weights[entry.first] = roundToSerializedPrecision(weights[entry.first] + entry.second * step);
+    }
+    return true;
+}
+
+#endif
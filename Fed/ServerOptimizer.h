@@ -0,0 +1,123 @@
+#ifndef __SERVEROPTIMIZER_H
+#define __SERVEROPTIMIZER_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * Optimiseur côté serveur (FedAvgM, FedAdam, FedYogi).
+ * La moyenne des modèles locaux moins le modèle global est traitée comme un
+ * pseudo-gradient ; l'état de l'optimiseur (moments) est conservé dans deux
+ * vecteurs plats, parcourus par des boucles simples vectorisables.
+ */
+class ServerOptimizer {
+public:
+    enum Type {
+        NONE,      // Remplacement par la moyenne (FedAvg)
+        MOMENTUM,  // FedAvgM
+        ADAM,      // FedAdam
+        YOGI       // FedYogi
+    };
+
+    /**
+     * Décode le nom d'un optimiseur
+     * @param name "none", "momentum", "adam" ou "yogi"
+     * @param type Type décodé
+     * @return true si le nom est connu
+     */
+    static bool parseType(const std::string& name, Type& type) {
+        if (name == "none") type = NONE;
+        else if (name == "momentum") type = MOMENTUM;
+        else if (name == "adam") type = ADAM;
+        else if (name == "yogi") type = YOGI;
+        else return false;
+        return true;
+    }
+
+    /**
+     * Constructeur
+     * @param optimizerType Règle de mise à jour
+     * @param lr Taux d'apprentissage du serveur
+     * @param b1 Coefficient du premier moment
+     * @param b2 Coefficient du second moment
+     * @param adaptivity Terme de stabilité (tau) des méthodes adaptatives
+     */
+    ServerOptimizer(Type optimizerType = NONE, double lr = 1.0, double b1 = 0.9, double b2 = 0.99, double adaptivity = 1e-3) :
+        type(optimizerType), learningRate(lr), beta1(b1), beta2(b2), tau(adaptivity) {}
+
+    /**
+     * Remet les moments à zéro ; le second moment part de tau², comme dans FedOpt,
+     * pour que le premier pas adaptatif reste proportionnel à la mise à jour
+     */
+    void reset() {
+        std::fill(m.begin(), m.end(), 0.0);
+        std::fill(v.begin(), v.end(), tau * tau);
+    }
+
+    /**
+     * Applique une étape de l'optimiseur au modèle global
+     * @param weights Poids du modèle global, mis à jour en place
+     * @param average Moyenne pondérée des modèles locaux de la ronde
+     */
+    void step(std::vector<double>& weights, const std::vector<double>& average) {
+        if (average.size() != weights.size()) {
+            throw std::runtime_error("Dimension des poids incorrecte");
+        }
+        if (type == NONE) {
+            weights = average;
+            return;
+        }
+        if (m.size() != weights.size()) {
+            m.resize(weights.size());
+            v.resize(weights.size());
+            reset();
+        }
+
+        double *w = weights.data();
+        const double *avg = average.data();
+        double *first = m.data();
+        double *second = v.data();
+        const size_t n = weights.size();
+
+        if (type == MOMENTUM) {
+            for (size_t i = 0; i < n; i++) {
+                first[i] = beta1 * first[i] + (avg[i] - w[i]);
+                w[i] += learningRate * first[i];
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            double delta = avg[i] - w[i];
+            double squared = delta * delta;
+            first[i] = beta1 * first[i] + (1 - beta1) * delta;
+            if (type == ADAM) {
+                second[i] = beta2 * second[i] + (1 - beta2) * squared;
+            }
+            else {
+                // Yogi : le second moment ne croît qu'additivement, ce qui limite la chute du pas
+                second[i] -= (1 - beta2) * squared * (second[i] > squared ? 1.0 : (second[i] < squared ? -1.0 : 0.0));
+            }
+            w[i] += learningRate * first[i] / (std::sqrt(second[i]) + tau);
+        }
+    }
+
+    Type getType() const {
+        return type;
+    }
+
+protected:
+    Type type;
+    double learningRate;
+    double beta1;
+    double beta2;
+    double tau;
+
+    std::vector<double> m;  // Premier moment
+    std::vector<double> v;  // Second moment
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef __SHAREDMODELREGISTRY_H
+#define __SHAREDMODELREGISTRY_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+/**
+ * Registre des instantanés immuables du modèle global, partagés par les modules UAV
+ * d'un même run. Le registre ne retient pas les instantanés (weak_ptr) :
+ * une version disparaît dès que plus aucun modèle ne la référence.
+ * Les clés incluent l'identifiant du run : dans un processus qui enchaîne les runs,
+ * un run ne réutilise jamais un instantané encore détenu par les modules d'un autre.
+ */
+class SharedModelRegistry {
+public:
+    typedef std::shared_ptr<const std::vector<double>> Snapshot;
+
+    /**
+     * Retourne l'instantané partagé d'une version du modèle global.
+     * Si un instantané identique de la même version est déjà référencé, il est réutilisé
+     * et les poids fournis sont libérés ; sinon un nouvel instantané est créé.
+     * @param runId Identifiant du run
+     * @param jobId Tâche d'apprentissage
+     * @param version Version du modèle global
+     * @param weights Poids reconstruits par l'appelant
+     * @return Instantané partagé
+     */
+    static Snapshot intern(const std::string& runId, int jobId, int version, std::vector<double>&& weights) {
+        auto& snapshots = getSnapshots();
+        purgeExpired(snapshots);
+
+        auto key = std::make_tuple(runId, jobId, version);
+        auto it = snapshots.find(key);
+        if (it != snapshots.end()) {
+            Snapshot existing = it->second.lock();
+            if (existing != nullptr && *existing == weights) {
+                return existing;
+            }
+            if (existing != nullptr) {
+                // Reconstruction différente (delta appliqué à une autre référence, par exemple) : non partagée
+                return std::make_shared<const std::vector<double>>(std::move(weights));
+            }
+        }
+
+        Snapshot snapshot = std::make_shared<const std::vector<double>>(std::move(weights));
+        snapshots[key] = snapshot;
+        return snapshot;
+    }
+
+    /**
+     * @param runId Identifiant du run
+     * @return Octets occupés par les instantanés du run encore référencés
+     */
+    static size_t getLiveBytes(const std::string& runId) {
+        size_t bytes = 0;
+        for (const auto& entry : getSnapshots()) {
+            if (std::get<0>(entry.first) != runId)
+                continue;
+            if (Snapshot snapshot = entry.second.lock()) {
+                bytes += snapshot->capacity() * sizeof(double);
+            }
+        }
+        return bytes;
+    }
+
+protected:
+    typedef std::map<std::tuple<std::string, int, int>, std::weak_ptr<const std::vector<double>>> SnapshotMap;
+
+    static SnapshotMap& getSnapshots() {
+        static SnapshotMap snapshots;
+        return snapshots;
+    }
+
+    static void purgeExpired(SnapshotMap& snapshots) {
+        for (auto it = snapshots.begin(); it != snapshots.end(); ) {
+            if (it->second.expired()) {
+                it = snapshots.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __SYNTHETICDATASET_H
+#define __SYNTHETICDATASET_H
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+/**
+ * Génère le jeu de données synthétique d'un UAV selon un modèle linéaire
+ * y = w1*x1 + w2*x2 + ... + biais + bruit.
+ * La graine dépend de uavId pour que chaque UAV ait des données différentes
+ * mais reproductibles, que l'UAV soit simulé avec ou sans réseau.
+ * Chaque tâche (jobId) a son propre modèle linéaire sous-jacent ; au-delà de la tâche 0,
+ * qui garde la graine d'origine, la graine combine (jobId, uavId) sans collision possible.
+ * @param uavId Identifiant de l'UAV
+ * @param jobId Identifiant de la tâche d'apprentissage
+ * @param numSamples Nombre d'échantillons (négatif : 100 + 20 * uavId)
+ * @return Ensemble de données (inputs, output)
+ */
+inline std::vector<std::pair<std::vector<double>, double>> generateSyntheticDataset(int uavId, int jobId = 0, int numSamples = -1) {
+    // Nombre d'échantillons de données, avec une légère variation par UAV
+    if (numSamples < 0) {
+        numSamples = 100 + (uavId * 20);
+    }
+
+    // Générateur de nombres aléatoires
+    std::mt19937 rng(uavId + 1000); // Utiliser uavId comme graine pour avoir des données différentes par UAV
+    if (jobId != 0) {
+        std::seed_seq seed{1000, jobId, uavId};
+        rng.seed(seed);
+    }
+    std::uniform_real_distribution<double> featureDist(-5.0, 5.0);
+    std::normal_distribution<double> noiseDist(0.0, 0.5);
+
+    // Générer des données selon un modèle linéaire simple y = w1*x1 + w2*x2 + ... + bruit
+    std::vector<double> trueWeights = {0.5, -1.2, 0.8, 2.0, -0.7};
+    double trueBias = 1.0 + jobId;
+
+    // Chaque tâche utilise une permutation différente des vrais poids
+    std::rotate(trueWeights.begin(), trueWeights.begin() + jobId % trueWeights.size(), trueWeights.end());
+
+    std::vector<std::pair<std::vector<double>, double>> data;
+    for (int i = 0; i < numSamples; i++) {
+        // Générer des features
+        std::vector<double> features;
+        for (size_t j = 0; j < trueWeights.size(); j++) {
+            features.push_back(featureDist(rng));
+        }
+
+        // Calculer la sortie avec le vrai modèle + bruit
+        double output = trueBias;
+        for (size_t j = 0; j < features.size(); j++) {
+            output += features[j] * trueWeights[j];
+        }
+        output += noiseDist(rng); // Ajouter du bruit
+
+        // Stocker la paire (features, output)
+        data.push_back(std::make_pair(features, output));
+    }
+
+    return data;
+}
+
+/**
+ * Génère un jeu de validation tiré du même modèle linéaire que les données de la tâche,
+ * avec une graine qu'aucun UAV n'utilise : les échantillons ne recoupent aucun jeu d'entraînement
+ * @param jobId Identifiant de la tâche d'apprentissage
+ * @param numSamples Nombre d'échantillons
+ * @return Ensemble de données (inputs, output)
+ */
+inline std::vector<std::pair<std::vector<double>, double>> generateSyntheticValidationSet(int jobId, int numSamples) {
+    return generateSyntheticDataset(-1, jobId, numSamples);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __TRAFFICCLASS_H
+#define __TRAFFICCLASS_H
+
+#include <omnetpp.h>
+#include "inet/common/packet/Packet.h"
+#include "inet/common/TimeTag_m.h"
+#include "inet/networklayer/common/DscpTag_m.h"
+#include "inet/linklayer/common/UserPriorityTag_m.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+/**
+ * Marque un paquet avec une classe de trafic.
+ * Le DSCP est appliqué dans l'en-tête IP ; la priorité utilisateur 802.11e
+ * (et donc la catégorie d'accès EDCA) est dérivée des 3 bits de poids fort du DSCP.
+ * @param packet Paquet à marquer
+ * @param dscp Code DSCP (0-63)
+ */
+inline void setTrafficClass(Packet *packet, int dscp) {
+    packet->addTagIfAbsent<DscpReq>()->setDifferentiatedServicesCodePoint(dscp);
+    packet->addTagIfAbsent<UserPriorityReq>()->setUserPriority(dscp >> 3);
+}
+
+/**
+ * Retourne l'horodatage de création le plus ancien porté par les régions d'un chunk
+ * @param data Données du paquet
+ * @return Horodatage le plus ancien (simTime() si aucune région n'est horodatée)
+ */
+inline simtime_t getOldestCreationTime(const Ptr<const Chunk>& data) {
+    simtime_t oldest = simTime();
+    for (const auto& region : data->getAllTags<CreationTimeTag>()) {
+        if (region.getTag()->getCreationTime() < oldest)
+            oldest = region.getTag()->getCreationTime();
+    }
+    return oldest;
+}
+
+#endif
@@ -1,22 +1,37 @@
 #include "UAVSensorAppFedAvg.h"
+#include <climits>
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/TimeTag_m.h"
 #include "inet/common/packet/chunk/ByteCountChunk.h"
 #include "inet/networklayer/common/L3AddressResolver.h"
 #include "inet/transportlayer/contract/udp/UdpControlInfo_m.h"
 #include "inet/networklayer/common/L3AddressTag_m.h"
+#include "inet/networklayer/common/HopLimitTag_m.h"
+#include "inet/networklayer/contract/ipv4/Ipv4Address.h"
+#include "TrafficClass.h"
+#include "SyntheticDataset.h"
+#include "ModelDelta.h"
 
 Define_Module(UAVSensorAppFedAvg);
 
 simsignal_t UAVSensorAppFedAvg::sentPkSignal = registerSignal("sentPk");
 simsignal_t UAVSensorAppFedAvg::rcvdPkSignal = registerSignal("rcvdPk");
 
-UAVSensorAppFedAvg::UAVSensorAppFedAvg() : localModel(5, 0.01, 32, 3) {
+UAVSensorAppFedAvg::UAVSensorAppFedAvg() {
 }
 
 UAVSensorAppFedAvg::~UAVSensorAppFedAvg() {
     cancelAndDelete(sendTimer);
-    cancelAndDelete(trainTimer);
+    cancelAndDelete(helloTimer);
+    cancelAndDelete(gossipTimer);
+    cancelAndDelete(consensusTimer);
+    for (auto& job : jobs) {
+        cancelAndDelete(job.trainTimer);
+        cancelAndDelete(job.computeTimer);
+        cancelAndDelete(job.uploadTimer);
+        cancelAndDelete(job.uploadAckTimer);
+        delete job.lastUpload;
+    }
 }
 
 void UAVSensorAppFedAvg::initialize(int stage) {
@@ -28,95 +43,153 @@ void UAVSensorAppFedAvg::initialize(int stage) {
         destPort = par("destPort");
         fedAvgPort = par("fedAvgPort");
         uavId = par("uavId");
+        numJobs = par("numJobs");
+        if (numJobs <= 0)
+            throw cRuntimeError("numJobs must be positive");
+        deltaDownlink = par("deltaDownlink");
+        runId = getEnvir()->getConfigEx()->getVariable(CFGVAR_RUNID);
+        fedAvgDscp = par("fedAvgDscp");
+        telemetryDscp = par("telemetryDscp");
+        telemetryBatchSize = par("telemetryBatchSize");
+        piggybackTelemetry = par("piggybackTelemetry");
+
+        std::string uploadScheduling = par("uploadScheduling").stdstringValue();
+        if (uploadScheduling == "closestApproach")
+            mobilityAwareUpload = true;
+        else if (uploadScheduling != "immediate")
+            throw cRuntimeError("Unknown upload scheduling '%s'", uploadScheduling.c_str());
+        uploadLookahead = par("uploadLookahead");
+        uploadGuardTime = par("uploadGuardTime");
+        predictionStep = par("predictionStep");
+        if (predictionStep <= SIMTIME_ZERO)
+            throw cRuntimeError("predictionStep must be positive");
+        uploadAckTimeout = par("uploadAckTimeout");
+        maxUploadRetries = par("maxUploadRetries");
+
+        deviceFlops = par("deviceFlops");
+        computeScale = par("computeScale");
+        adaptiveLocalWork = par("adaptiveLocalWork");
+        localTimeBudget = par("localTimeBudget");
+        maxLocalSteps = par("maxLocalSteps");
+        holdoutFraction = par("holdoutFraction");
+        if (holdoutFraction < 0 || holdoutFraction >= 1)
+            throw cRuntimeError("holdoutFraction must be in [0, 1)");
+        if (adaptiveLocalWork && deviceFlops <= 0)
+            throw cRuntimeError("adaptiveLocalWork requires a positive deviceFlops");
+
+        computeEnergyPerFlop = par("computeEnergyPerFlop");
+        radioEnergyPerBit = par("radioEnergyPerBit");
+        batteryCapacity = par("batteryCapacity");
+        lowEnergyThreshold = par("lowEnergyThreshold");
+        const char *energyStorageModule = par("energyStorageModule");
+        if (*energyStorageModule != '\0') {
+            // La puissance de calcul n'est tirée du stockage que pendant une durée d'entraînement non nulle
+            if (deviceFlops <= 0)
+                throw cRuntimeError("energyStorageModule requires a positive deviceFlops");
+            energyStorage = getModuleFromPar<power::IEpEnergyStorage>(par("energyStorageModule"), this);
+            energyStorage->addEnergyConsumer(this);
+        }
+
+        gossipMode = par("gossipMode");
+        gossipInterval = par("gossipInterval");
+        gossipFanout = par("gossipFanout");
+        mixingWeight = par("mixingWeight");
+        helloInterval = par("helloInterval");
+        neighbourTimeout = par("neighbourTimeout");
+        consensusReportInterval = par("consensusReportInterval");
 
         trainingCompletedSignal = registerSignal("trainingCompleted");
         localAccuracySignal = registerSignal("localAccuracy");
+        telemetryBatchSignal = registerSignal("telemetryBatch");
+        uploadDistanceSignal = registerSignal("uploadDistance");
+        uploadDeferralSignal = registerSignal("uploadDeferral");
+        uploadRetriesSignal = registerSignal("uploadRetries");
+        fedAvgBytesSentSignal = registerSignal("fedAvgBytesSent");
+        neighboursSignal = registerSignal("neighbours");
+        mixingWeightSignal = registerSignal("mixingWeight");
+        privateModelBytesSignal = registerSignal("privateModelBytes");
+        sharedModelBytesSignal = registerSignal("sharedModelBytes");
+        localStepsSignal = registerSignal("localSteps");
+        computeTimeSignal = registerSignal("computeTime");
+        energyConsumedSignal = registerSignal("energyConsumed");
+        batteryLevelSignal = registerSignal("batteryLevel");
 
         numSent = 0;
         numReceived = 0;
-        currentRound = 0;
-        trainingInProgress = false;
 
         WATCH(numSent);
         WATCH(numReceived);
-        WATCH(currentRound);
-        WATCH(trainingInProgress);
+        WATCH(numGossipExchanges);
+
+        // Créer l'état de chaque tâche et générer ses données synthétiques
+        jobs.resize(numJobs);
+        for (int i = 0; i < numJobs; i++) {
+            jobs[i].jobId = i;
+            jobs[i].localModel.seed(intuniform(0, INT_MAX));
+            generateSyntheticData(jobs[i]);
+        }
 
-        // Générer des données synthétiques pour l'entraînement
-        generateSyntheticData();
+        // Timers alloués une seule fois ; handleStartOperation() les planifie à chaque démarrage
+        sendTimer = new cMessage("sendTimer");
+        createJobTimers();
     }
     else if (stage == INITSTAGE_APPLICATION_LAYER) {
-        // Configuration du socket
-        socket.setOutputGate(gate("socketOut"));
-        socket.setCallback(this);
-        
-        // Only bind the socket here if localPort is specified
-        if (localPort > 0) {
-            socket.bind(localPort);
-        }
-
-        // Résolution de l'adresse de la station de base pour les données normales
-        const char *destAddrs = par("destAddresses");
-        cStringTokenizer tokenizer(destAddrs);
-        const char *token;
-
-        while ((token = tokenizer.nextToken()) != nullptr) {
-            L3AddressResolver().tryResolve(token, destAddress);
-            if (destAddress.isUnspecified())
-                EV_ERROR << "Cannot resolve destination address: " << token << endl;
-            baseStationAddress = destAddress; // Utiliser la même adresse pour FedAvg
-            break;
+        // Les sockets et les timers sont démarrés par handleStartOperation(), appelé au début de cette étape
+
+        // Mobilité du nœud, utilisée pour prédire la trajectoire ; pour une orbite
+        // circulaire (CircleMobility), le centre et le rayon sont lus dans ses paramètres
+        cModule *mobilityModule = getContainingNode(this)->getSubmodule("mobility");
+        mobility = dynamic_cast<IMobility *>(mobilityModule);
+        if (mobility != nullptr && mobilityModule->hasPar("cx") && mobilityModule->hasPar("r")) {
+            orbitCentre = Coord(mobilityModule->par("cx").doubleValue(), mobilityModule->par("cy").doubleValue());
+            orbitRadius = mobilityModule->par("r").doubleValue();
         }
 
-        // Configurer les timers
-        sendTimer = new cMessage("sendTimer");
-        trainTimer = new cMessage("trainTimer");
+        EV_INFO << "UAV[" << uavId << "] Sensor App FedAvg initialized. Ready to participate in federated learning." << endl;
+    }
+}
 
-        if (!destAddress.isUnspecified() && operationalState == State::OPERATING) {
-            scheduleAt(simTime() + par("startTime"), sendTimer);
-        }
+void UAVSensorAppFedAvg::createJobTimers() {
+    // Le kind des timers porte l'indice de la tâche
+    for (auto& job : jobs) {
+        job.trainTimer = new cMessage("trainTimer", job.jobId);
+        job.computeTimer = new cMessage("computeTimer", job.jobId);
+        job.uploadTimer = new cMessage("uploadTimer", job.jobId);
+        job.uploadAckTimer = new cMessage("uploadAckTimer", job.jobId);
+    }
+}
 
-        EV_INFO << "UAV[" << uavId << "] Sensor App FedAvg initialized. Ready to participate in federated learning." << endl;
+void UAVSensorAppFedAvg::cancelJobTimers() {
+    for (auto& job : jobs) {
+        cancelEvent(job.trainTimer);
+        cancelEvent(job.computeTimer);
+        cancelEvent(job.uploadTimer);
+        cancelEvent(job.uploadAckTimer);
+        delete job.lastUpload;
+        job.lastUpload = nullptr;
+        job.trainingInProgress = false;
     }
+    updateComputePower();
 }
 
-void UAVSensorAppFedAvg::generateSyntheticData() {
+void UAVSensorAppFedAvg::generateSyntheticData(UavJob& job) {
     // Générer des données synthétiques pour l'entraînement
     // Dans un cas réel, cela serait remplacé par des données réelles collectées par l'UAV
-    EV_INFO << "Generating synthetic training data for UAV " << uavId << endl;
-
-    // Nombre d'échantillons de données, avec une légère variation par UAV
-    int numSamples = 100 + (uavId * 20);
-
-    // Générateur de nombres aléatoires
-    std::mt19937 rng(uavId + 1000); // Utiliser uavId comme graine pour avoir des données différentes par UAV
-    std::uniform_real_distribution<double> featureDist(-5.0, 5.0);
-    std::normal_distribution<double> noiseDist(0.0, 0.5);
-
-    // Générer des données selon un modèle linéaire simple y = w1*x1 + w2*x2 + ... + bruit
-    std::vector<double> trueWeights = {0.5, -1.2, 0.8, 2.0, -0.7};
-    double trueBias = 1.0;
-
-    trainingData.clear();
-    for (int i = 0; i < numSamples; i++) {
-        // Générer des features
-        std::vector<double> features;
-        for (size_t j = 0; j < trueWeights.size(); j++) {
-            features.push_back(featureDist(rng));
-        }
+    EV_INFO << "Generating synthetic training data for UAV " << uavId << ", job " << job.jobId << endl;
 
-        // Calculer la sortie avec le vrai modèle + bruit
-        double output = trueBias;
-        for (size_t j = 0; j < features.size(); j++) {
-            output += features[j] * trueWeights[j];
-        }
-        output += noiseDist(rng); // Ajouter du bruit
+    job.trainingData = generateSyntheticDataset(uavId, job.jobId);
+    job.holdoutData.clear();
+    job.dataGeneration++;
 
-        // Stocker la paire (features, output)
-        trainingData.push_back(std::make_pair(features, output));
+    // Les derniers échantillons sont réservés à l'évaluation et ne servent jamais à l'entraînement
+    size_t holdoutSize = static_cast<size_t>(std::round(holdoutFraction * job.trainingData.size()));
+    if (holdoutSize > 0 && holdoutSize < job.trainingData.size()) {
+        job.holdoutData.assign(job.trainingData.end() - holdoutSize, job.trainingData.end());
+        job.trainingData.resize(job.trainingData.size() - holdoutSize);
     }
 
-    EV_INFO << "Generated " << numSamples << " training samples for UAV " << uavId << endl;
+    EV_INFO << "Generated " << job.trainingData.size() << " training samples and " << job.holdoutData.size()
+            << " held-out samples for UAV " << uavId << endl;
 }
 
 void UAVSensorAppFedAvg::handleMessageWhenUp(cMessage *msg) {
@@ -125,10 +198,37 @@ void UAVSensorAppFedAvg::handleMessageWhenUp(cMessage *msg) {
             sendSensorData();
             scheduleAt(simTime() + sendInterval, sendTimer);
         }
-        else if (msg == trainTimer) {
-            trainLocalModel();
+        else if (msg == helloTimer) {
+            sendHello();
+            scheduleAt(simTime() + helloInterval, helloTimer);
+        }
+        else if (msg == gossipTimer) {
+            gossipRound();
+            scheduleAt(simTime() + gossipInterval, gossipTimer);
+        }
+        else if (msg == consensusTimer) {
+            sendConsensusSamples();
+            scheduleAt(simTime() + consensusReportInterval, consensusTimer);
+        }
+        else {
+            UavJob& job = jobs.at(msg->getKind());
+            if (msg == job.trainTimer) {
+                trainLocalModel(job);
+            }
+            else if (msg == job.computeTimer) {
+                completeLocalTraining(job);
+            }
+            else if (msg == job.uploadTimer) {
+                sendModelUpdate(job);
+            }
+            else if (msg == job.uploadAckTimer) {
+                retransmitModelUpdate(job);
+            }
         }
     }
+    else if (fedAvgSocket.belongsToSocket(msg)) {
+        fedAvgSocket.processMessage(msg);
+    }
     else {
         socket.processMessage(msg);
     }
@@ -144,19 +244,28 @@ void UAVSensorAppFedAvg::collectSensorData() {
 void UAVSensorAppFedAvg::sendSensorData() {
     collectSensorData();
 
+    // Mettre le relevé en attente ; il partira dans une trame groupée ou avec le prochain modèle
+    pendingTelemetry.push_back(simTime());
+
+    // Pendant une ronde active, la télémétrie attend l'envoi du modèle pour y être ajoutée
+    bool waitForUpload = piggybackTelemetry && isRoundActive();
+
+    if (!waitForUpload && static_cast<int>(pendingTelemetry.size()) >= telemetryBatchSize) {
+        flushTelemetry();
+    }
+}
+
+void UAVSensorAppFedAvg::flushTelemetry() {
+    if (pendingTelemetry.empty())
+        return;
+
     char msgName[32];
     sprintf(msgName, "UAVSensorData-%d-%d", uavId, numSent);
 
-    // Créer un paquet avec les données du capteur
+    // Créer un paquet regroupant les relevés en attente
     Packet *packet = new Packet(msgName);
-
-    // Ajouter un tag de temps pour mesurer la latence
-    auto creationTimeTag = packet->addTag<CreationTimeTag>();
-    creationTimeTag->setCreationTime(simTime());
-
-    // Simuler les données du capteur avec un payload de taille fixe
-    const auto& payload = makeShared<ByteCountChunk>(B(par("messageLength")));
-    packet->insertAtBack(payload);
+    appendPendingTelemetry(packet);
+    setTrafficClass(packet, telemetryDscp);
 
     // Envoyer à la station de base
     socket.sendTo(packet, destAddress, destPort);
@@ -165,55 +274,191 @@ void UAVSensorAppFedAvg::sendSensorData() {
     emit(sentPkSignal, packet);
 }
 
-void UAVSensorAppFedAvg::trainLocalModel() {
-    if (trainingData.empty()) {
+void UAVSensorAppFedAvg::appendPendingTelemetry(Packet *packet) {
+    // Un chunk de taille fixe par relevé, horodaté individuellement pour mesurer la latence
+    for (simtime_t creationTime : pendingTelemetry) {
+        const auto& payload = makeShared<ByteCountChunk>(B(par("messageLength")));
+        payload->addTag<CreationTimeTag>()->setCreationTime(creationTime);
+        packet->insertAtBack(payload);
+    }
+
+    emit(telemetryBatchSignal, static_cast<int>(pendingTelemetry.size()));
+    pendingTelemetry.clear();
+}
+
+bool UAVSensorAppFedAvg::isRoundActive() const {
+    for (const auto& job : jobs) {
+        if (job.trainingInProgress)
+            return true;
+    }
+    return false;
+}
+
+void UAVSensorAppFedAvg::trainLocalModel(UavJob& job) {
+    if (job.trainingData.empty()) {
         EV_WARN << "UAV[" << uavId << "] has no training data available" << endl;
+        job.trainingInProgress = false;
         return;
     }
 
-    EV_INFO << "UAV[" << uavId << "] training local model for round " << currentRound << endl;
+    EV_INFO << "UAV[" << uavId << "] training local model for job " << job.jobId
+            << ", round " << job.currentRound << endl;
+
+    // Batterie épuisée : l'UAV ne participe plus
+    double batteryLevel = getBatteryLevel();
+    if (batteryLevel == 0) {
+        EV_WARN << "UAV[" << uavId << "] battery depleted, skipping local training for job " << job.jobId << endl;
+        job.trainingInProgress = false;
+        return;
+    }
+
+    // Nombre de pas : numEpochs passes complètes, ou adapté à la vitesse de l'UAV et au budget
+    size_t numSamples = job.trainingData.size();
+    job.localSteps = adaptiveLocalWork ? computeLocalSteps(job) : job.localModel.getDefaultSteps(numSamples);
+
+    // Batterie faible : travail local réduit en proportion de l'énergie restante
+    if (batteryLevel > 0 && batteryLevel < lowEnergyThreshold) {
+        job.localSteps = std::max(1, static_cast<int>(job.localSteps * batteryLevel / lowEnergyThreshold));
+    }
+
+    // Entraîner le modèle local avec les données ; le résultat n'est disponible qu'après la durée du calcul
+    job.localModel.trainSteps(job.trainingData, job.localSteps);
+    job.trainedGeneration = job.dataGeneration;
+
+    // Les poids privés sont matérialisés : sans delta à appliquer, l'instantané partagé n'est plus retenu
+    if (!deltaDownlink) {
+        job.globalWeights.reset();
+    }
 
-    // Entraîner le modèle local avec les données
-    localModel.train(trainingData);
+    double flops = job.localModel.estimateTrainingFlops(numSamples, job.localSteps) * computeScale;
+    computeEnergy += flops * computeEnergyPerFlop;
+
+    simtime_t computeTime = SIMTIME_ZERO;
+    if (deviceFlops > 0) {
+        computeTime = flops / deviceFlops;
+    }
+    emit(localStepsSignal, job.localSteps);
+    emit(computeTimeSignal, computeTime);
+
+    if (computeTime > SIMTIME_ZERO) {
+        scheduleAt(simTime() + computeTime, job.computeTimer);
+        updateComputePower();
+    }
+    else {
+        completeLocalTraining(job);
+    }
+}
+
+int UAVSensorAppFedAvg::computeLocalSteps(UavJob& job) {
+    // Le calcul doit aussi laisser le temps d'envoyer la mise à jour avant l'échéance
+    simtime_t budget = localTimeBudget;
+    if (job.roundDeadline > simTime() && job.roundDeadline - simTime() - uploadGuardTime < budget) {
+        budget = job.roundDeadline - simTime() - uploadGuardTime;
+    }
+
+    double flopsPerStep = job.localModel.estimateTrainingFlops(job.trainingData.size(), 1) * computeScale;
+    int steps = static_cast<int>(budget.dbl() * deviceFlops / flopsPerStep);
+    return std::max(1, std::min(steps, maxLocalSteps));
+}
+
+void UAVSensorAppFedAvg::completeLocalTraining(UavJob& job) {
+    updateComputePower();
+    emitEnergy();
 
     // Évaluer le modèle pour obtenir une métrique de performance
-    double accuracy = evaluateModel();
+    double accuracy = evaluateModel(job);
 
     // Émettre un signal de fin d'entraînement
-    emit(trainingCompletedSignal, currentRound);
+    emit(trainingCompletedSignal, job.currentRound);
     emit(localAccuracySignal, accuracy);
+    emitModelMemory();
 
-    EV_INFO << "UAV[" << uavId << "] training completed with accuracy: " << accuracy << endl;
+    EV_INFO << "UAV[" << uavId << "] training completed (" << job.localSteps << " steps) with accuracy: "
+            << accuracy << endl;
 
     // Envoyer les mises à jour du modèle à la station de base
-    sendModelUpdate();
+    scheduleModelUpload(job);
+}
+
+double UAVSensorAppFedAvg::evaluateModel(UavJob& job) {
+    // Sans échantillons réservés, la précision est celle mesurée sur les données d'entraînement
+    // pendant la dernière époque (chaque lot avant sa mise à jour), tant que les poids n'ont pas
+    // changé depuis : l'évaluation ne coûte aucune passe supplémentaire
+    if (job.holdoutData.empty() && job.trainedGeneration == job.dataGeneration && job.localModel.hasLastPassMetrics()) {
+        return job.localModel.getLastPassMetrics().accuracy;
+    }
 
-    trainingInProgress = false;
+    // Sinon, évaluer sur les échantillons réservés, ou à défaut sur les données d'entraînement ;
+    // le modèle garde les métriques de sa révision actuelle, les appels répétés au cours d'une
+    // ronde (fin d'entraînement, envoi, retransmission) ne reparcourent pas les données
+    return job.localModel.evaluate(job.holdoutData.empty() ? job.trainingData : job.holdoutData, job.dataGeneration);
 }
 
-double UAVSensorAppFedAvg::evaluateModel() {
-    // Évaluer le modèle sur un ensemble de validation
-    // Dans cet exemple, nous utilisons simplement l'erreur moyenne sur les données d'entraînement
-    double totalError = 0.0;
+bool UAVSensorAppFedAvg::resolveBaseStationPosition() {
+    if (!baseStationPositionKnown) {
+        cModule *host = L3AddressResolver().findHostWithAddress(baseStationAddress);
+        auto baseStationMobility = host != nullptr ? dynamic_cast<IMobility *>(host->getSubmodule("mobility")) : nullptr;
+        if (baseStationMobility != nullptr) {
+            baseStationPosition = baseStationMobility->getCurrentPosition();
+            baseStationPositionKnown = true;
+        }
+    }
+    return baseStationPositionKnown;
+}
 
-    for (const auto& sample : trainingData) {
-        const auto& features = sample.first;
-        double target = sample.second;
+Coord UAVSensorAppFedAvg::predictPosition(simtime_t delta) {
+    Coord position = mobility->getCurrentPosition();
+    Coord velocity = mobility->getCurrentVelocity();
+
+    if (orbitRadius > 0) {
+        // Orbite circulaire : le sens de rotation est déduit de la vitesse actuelle
+        double dx = position.x - orbitCentre.x;
+        double dy = position.y - orbitCentre.y;
+        double direction = (dx * velocity.y - dy * velocity.x) >= 0 ? 1.0 : -1.0;
+        double angle = std::atan2(dy, dx) + direction * velocity.length() / orbitRadius * delta.dbl();
+        return Coord(orbitCentre.x + orbitRadius * std::cos(angle), orbitCentre.y + orbitRadius * std::sin(angle), position.z);
+    }
+
+    // Autres mobilités : extrapolation linéaire
+    return position + velocity * delta.dbl();
+}
 
-        double prediction = localModel.predict(features);
-        double error = std::abs(prediction - target);
-        totalError += error;
+void UAVSensorAppFedAvg::scheduleModelUpload(UavJob& job) {
+    // Échéance déjà passée : la mise à jour part sans attendre
+    if (!mobilityAwareUpload || mobility == nullptr || simTime() >= job.roundDeadline || !resolveBaseStationPosition()) {
+        sendModelUpdate(job);
+        return;
+    }
+
+    // Fenêtre de recherche, bornée par l'échéance de la ronde moins une marge pour les retransmissions
+    simtime_t windowEnd = std::min(simTime() + uploadLookahead, job.roundDeadline - uploadGuardTime);
+
+    // En espace libre, la distance minimale à la station de base donne le meilleur SNR attendu
+    simtime_t bestDelta = 0;
+    double bestDistance = mobility->getCurrentPosition().distance(baseStationPosition);
+    for (simtime_t delta = predictionStep; simTime() + delta <= windowEnd; delta += predictionStep) {
+        double distance = predictPosition(delta).distance(baseStationPosition);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestDelta = delta;
+        }
     }
 
-    double avgError = totalError / trainingData.size();
-    double accuracy = 1.0 / (1.0 + avgError); // Convertir l'erreur en une mesure de "précision"
+    emit(uploadDeferralSignal, bestDelta);
 
-    return accuracy;
+    if (bestDelta.isZero()) {
+        sendModelUpdate(job);
+    }
+    else {
+        EV_INFO << "UAV[" << uavId << "] deferring model upload by " << bestDelta
+                << "s, predicted distance to base station: " << bestDistance << "m" << endl;
+        scheduleAt(simTime() + bestDelta, job.uploadTimer);
+    }
 }
 
-void UAVSensorAppFedAvg::sendModelUpdate() {
-    char msgName[32];
-    sprintf(msgName, "ModelUpdate-UAV%d-Round%d", uavId, currentRound);
+void UAVSensorAppFedAvg::sendModelUpdate(UavJob& job) {
+    char msgName[64];
+    sprintf(msgName, "ModelUpdate-UAV%d-Job%d-Round%d", uavId, job.jobId, job.currentRound);
 
     // Créer un paquet pour le message FedAvg
     Packet *packet = new Packet(msgName);
@@ -221,19 +466,339 @@ void UAVSensorAppFedAvg::sendModelUpdate() {
     // Créer le message FedAvg
     const auto& fedAvgMsg = makeShared<FedAvgMessage>();
     fedAvgMsg->setMessageType(LOCAL_UPDATE);
-    fedAvgMsg->setRoundId(currentRound);
-    fedAvgMsg->setModelWeights(localModel.serialize().c_str());
+    fedAvgMsg->setJobId(job.jobId);
+    fedAvgMsg->setRoundId(job.currentRound);
+    fedAvgMsg->setModelWeights(job.localModel.serialize().c_str());
     fedAvgMsg->setUavId(uavId);
-    fedAvgMsg->setAccuracy(evaluateModel());
-    fedAvgMsg->setSamplesCount(trainingData.size());
+    fedAvgMsg->setAccuracy(evaluateModel(job));
+    fedAvgMsg->setSamplesCount(job.trainingData.size());
+    fedAvgMsg->setModelVersion(job.globalVersion);
+    fedAvgMsg->setLocalSteps(job.localSteps);
+    fedAvgMsg->setBatteryLevel(getBatteryLevel());
+    fedAvgMsg->setEnergyConsumed(computeEnergy + radioEnergy);
+    if (piggybackTelemetry) {
+        fedAvgMsg->setTelemetrySamples(pendingTelemetry.size());
+    }
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
 
     // Ajouter le message au paquet
     packet->insertAtBack(fedAvgMsg);
 
+    // Ajouter la télémétrie en attente derrière le modèle
+    if (piggybackTelemetry && !pendingTelemetry.empty()) {
+        appendPendingTelemetry(packet);
+    }
+    setTrafficClass(packet, fedAvgDscp);
+
+    // Une mise à jour précédente encore sans accusé de réception est abandonnée
+    if (job.lastUpload != nullptr) {
+        completeModelUpload(job, false);
+    }
+
+    // Conserver une copie pour la retransmission en l'absence d'accusé de réception
+    job.uploadRetries = 0;
+    if (maxUploadRetries > 0) {
+        job.lastUpload = packet->dup();
+        scheduleAt(simTime() + uploadAckTimeout, job.uploadAckTimer);
+    }
+
+    if (mobility != nullptr && resolveBaseStationPosition()) {
+        emit(uploadDistanceSignal, mobility->getCurrentPosition().distance(baseStationPosition));
+    }
+
     // Envoyer à la station de base
-    socket.sendTo(packet, baseStationAddress, fedAvgPort);
+    sendFedAvgPacket(packet, baseStationAddress);
 
-    EV_INFO << "UAV[" << uavId << "] sent model update to base station for round " << currentRound << endl;
+    job.trainingInProgress = false;
+
+    EV_INFO << "UAV[" << uavId << "] sent model update to base station for job " << job.jobId
+            << ", round " << job.currentRound << endl;
+}
+
+void UAVSensorAppFedAvg::retransmitModelUpdate(UavJob& job) {
+    if (job.uploadRetries >= maxUploadRetries) {
+        EV_WARN << "UAV[" << uavId << "] model update for job " << job.jobId << ", round " << job.currentRound
+                << " not acknowledged after " << job.uploadRetries << " retries" << endl;
+        completeModelUpload(job, false);
+        return;
+    }
+
+    job.uploadRetries++;
+    sendFedAvgPacket(job.lastUpload->dup(), baseStationAddress);
+    scheduleAt(simTime() + uploadAckTimeout, job.uploadAckTimer);
+
+    EV_INFO << "UAV[" << uavId << "] retransmitting model update for job " << job.jobId
+            << ", round " << job.currentRound << " (retry " << job.uploadRetries << ")" << endl;
+}
+
+void UAVSensorAppFedAvg::completeModelUpload(UavJob& job, bool acknowledged) {
+    cancelEvent(job.uploadAckTimer);
+    if (!acknowledged) {
+        numUploadsLost++;
+    }
+    emit(uploadRetriesSignal, job.uploadRetries);
+
+    delete job.lastUpload;
+    job.lastUpload = nullptr;
+}
+
+bool UAVSensorAppFedAvg::updateGlobalModel(UavJob& job, const FedAvgMessage *msg) {
+    std::vector<double> newWeights;
+
+    if (msg->getBaseVersion() < 0) {
+        // Version complète
+        if (!FederatedLearningModel::parseWeights(msg->getModelWeights(), newWeights) ||
+                newWeights.size() != job.localModel.getWeights().size()) {
+            EV_WARN << "UAV[" << uavId << "] cannot deserialize global model" << endl;
+            return false;
+        }
+    }
+    else {
+        // Delta par rapport à la version précédente
+        if (msg->getBaseVersion() != job.globalVersion || job.globalWeights == nullptr) {
+            EV_INFO << "UAV[" << uavId << "] cannot apply delta from version " << msg->getBaseVersion()
+                    << ", holding version " << job.globalVersion << endl;
+            return false;
+        }
+        newWeights = *job.globalWeights;
+        if (!applyModelDelta(msg->getModelWeights(), newWeights, msg->getDeltaStep())) {
+            EV_WARN << "UAV[" << uavId << "] cannot decode global model delta" << endl;
+            return false;
+        }
+    }
+
+    // Les UAVs du processus qui reconstruisent la même version partagent un seul exemplaire
+    job.globalWeights = SharedModelRegistry::intern(runId, job.jobId, msg->getModelVersion(), std::move(newWeights));
+    job.globalVersion = msg->getModelVersion();
+    return true;
+}
+
+void UAVSensorAppFedAvg::emitModelMemory() {
+    // Poids alloués en propre par cet UAV, et poids globaux partagés par tout le processus
+    size_t privateBytes = 0;
+    for (const auto& job : jobs) {
+        privateBytes += job.localModel.getPrivateBytes();
+    }
+    emit(privateModelBytesSignal, static_cast<long>(privateBytes));
+    emit(sharedModelBytesSignal, static_cast<long>(SharedModelRegistry::getLiveBytes(runId)));
+}
+
+void UAVSensorAppFedAvg::requestGlobalSnapshot(UavJob& job) {
+    char msgName[64];
+    sprintf(msgName, "SnapshotRequest-UAV%d-Job%d", uavId, job.jobId);
+    Packet *packet = new Packet(msgName);
+
+    const auto& fedAvgMsg = makeShared<FedAvgMessage>();
+    fedAvgMsg->setMessageType(SNAPSHOT_REQUEST);
+    fedAvgMsg->setJobId(job.jobId);
+    fedAvgMsg->setUavId(uavId);
+    fedAvgMsg->setModelVersion(job.globalVersion);
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
+
+    packet->insertAtBack(fedAvgMsg);
+    setTrafficClass(packet, fedAvgDscp);
+    sendFedAvgPacket(packet, baseStationAddress);
+}
+
+void UAVSensorAppFedAvg::sendFedAvgPacket(Packet *packet, L3Address destAddr) {
+    // Comptabiliser les octets de modèle émis, pour comparer topologie en étoile et gossip
+    fedAvgBytesSent += B(packet->getDataLength()).get();
+    emit(fedAvgBytesSentSignal, B(packet->getDataLength()).get());
+    radioEnergy += b(packet->getDataLength()).get() * radioEnergyPerBit;
+
+    fedAvgSocket.sendTo(packet, destAddr, fedAvgPort);
+}
+
+double UAVSensorAppFedAvg::getBatteryLevel() const {
+    // Avec un stockage INET, le niveau tient compte de toute la consommation du nœud (radio comprise)
+    if (energyStorage != nullptr) {
+        J nominal = energyStorage->getNominalEnergyCapacity();
+        return nominal > J(0) ? std::max(0.0, energyStorage->getResidualEnergyCapacity().get() / nominal.get()) : -1;
+    }
+    if (batteryCapacity > 0) {
+        return std::max(0.0, 1 - (computeEnergy + radioEnergy) / batteryCapacity);
+    }
+    return -1;
+}
+
+void UAVSensorAppFedAvg::updateComputePower() {
+    if (energyStorage == nullptr)
+        return;
+
+    // Chaque entraînement en cours tire la puissance du processeur à pleine charge
+    int activeComputations = 0;
+    for (const auto& job : jobs) {
+        if (job.computeTimer != nullptr && job.computeTimer->isScheduled())
+            activeComputations++;
+    }
+    W power = W(activeComputations * deviceFlops * computeEnergyPerFlop);
+    if (power != computePowerConsumption) {
+        computePowerConsumption = power;
+        emit(IEpEnergyConsumer::powerConsumptionChangedSignal, computePowerConsumption.get());
+    }
+}
+
+void UAVSensorAppFedAvg::emitEnergy() {
+    emit(energyConsumedSignal, computeEnergy + radioEnergy);
+    double batteryLevel = getBatteryLevel();
+    if (batteryLevel >= 0) {
+        emit(batteryLevelSignal, batteryLevel);
+    }
+}
+
+void UAVSensorAppFedAvg::startGossip() {
+    if (helloTimer == nullptr) {
+        helloTimer = new cMessage("helloTimer");
+        gossipTimer = new cMessage("gossipTimer");
+        consensusTimer = new cMessage("consensusTimer");
+    }
+
+    // Les premières annonces précèdent le premier échange pour remplir la table de voisinage
+    simtime_t start = simTime() + par("startTime");
+    scheduleAt(start, helloTimer);
+    scheduleAt(start + gossipInterval, gossipTimer);
+    if (!baseStationAddress.isUnspecified()) {
+        scheduleAt(start + consensusReportInterval, consensusTimer);
+    }
+}
+
+void UAVSensorAppFedAvg::stopGossip() {
+    if (helloTimer != nullptr) {
+        cancelEvent(helloTimer);
+        cancelEvent(gossipTimer);
+        cancelEvent(consensusTimer);
+    }
+    neighbours.clear();
+}
+
+void UAVSensorAppFedAvg::sendHello() {
+    char msgName[32];
+    sprintf(msgName, "Hello-UAV%d", uavId);
+    Packet *packet = new Packet(msgName);
+
+    const auto& fedAvgMsg = makeShared<FedAvgMessage>();
+    fedAvgMsg->setMessageType(NEIGHBOUR_HELLO);
+    fedAvgMsg->setUavId(uavId);
+    fedAvgMsg->setDegree(neighbours.size());
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
+
+    packet->insertAtBack(fedAvgMsg);
+    setTrafficClass(packet, fedAvgDscp);
+
+    // Diffusion limitée aux voisins à un saut
+    packet->addTag<HopLimitReq>()->setHopLimit(1);
+    sendFedAvgPacket(packet, Ipv4Address::ALLONES_ADDRESS);
+}
+
+void UAVSensorAppFedAvg::pruneNeighbours() {
+    for (auto it = neighbours.begin(); it != neighbours.end(); ) {
+        if (simTime() - it->second.lastSeen > neighbourTimeout) {
+            EV_INFO << "UAV[" << uavId << "] lost neighbour UAV " << it->first << endl;
+            it = neighbours.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void UAVSensorAppFedAvg::gossipRound() {
+    pruneNeighbours();
+    emit(neighboursSignal, static_cast<int>(neighbours.size()));
+
+    std::vector<int> candidates;
+    for (const auto& entry : neighbours) {
+        candidates.push_back(entry.first);
+    }
+    int fanout = std::min(gossipFanout, static_cast<int>(candidates.size()));
+
+    for (auto& job : jobs) {
+        // Une étape d'entraînement local entre deux échanges
+        job.currentRound++;
+        job.localModel.train(job.trainingData);
+        job.trainedGeneration = job.dataGeneration;
+        computeEnergy += job.localModel.estimateTrainingFlops(job.trainingData.size(),
+                job.localModel.getDefaultSteps(job.trainingData.size())) * computeScale * computeEnergyPerFlop;
+        emit(trainingCompletedSignal, job.currentRound);
+        emit(localAccuracySignal, evaluateModel(job));
+
+        // Tirage sans remise de quelques voisins (Fisher-Yates partiel)
+        for (int k = 0; k < fanout; k++) {
+            int pick = intuniform(k, candidates.size() - 1);
+            std::swap(candidates[k], candidates[pick]);
+            sendLocalModel(job, GOSSIP_MODEL, neighbours[candidates[k]].address);
+        }
+    }
+
+    EV_INFO << "UAV[" << uavId << "] gossip round with " << fanout << " of "
+            << neighbours.size() << " neighbours" << endl;
+}
+
+void UAVSensorAppFedAvg::sendLocalModel(UavJob& job, int messageType, L3Address destAddr) {
+    char msgName[64];
+    sprintf(msgName, "%s-UAV%d-Job%d", messageType == CONSENSUS_SAMPLE ? "ConsensusSample" : "Gossip",
+            uavId, job.jobId);
+    Packet *packet = new Packet(msgName);
+
+    const auto& fedAvgMsg = makeShared<FedAvgMessage>();
+    fedAvgMsg->setMessageType(messageType);
+    fedAvgMsg->setJobId(job.jobId);
+    fedAvgMsg->setRoundId(job.currentRound);
+    fedAvgMsg->setModelWeights(job.localModel.serialize().c_str());
+    fedAvgMsg->setUavId(uavId);
+    fedAvgMsg->setAccuracy(evaluateModel(job));
+    fedAvgMsg->setSamplesCount(job.trainingData.size());
+    fedAvgMsg->setDegree(neighbours.size());
+    fedAvgMsg->setBatteryLevel(getBatteryLevel());
+    fedAvgMsg->setEnergyConsumed(computeEnergy + radioEnergy);
+    fedAvgMsg->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    updateFedAvgMessageLength(fedAvgMsg.get());
+
+    packet->insertAtBack(fedAvgMsg);
+    setTrafficClass(packet, fedAvgDscp);
+    sendFedAvgPacket(packet, destAddr);
+}
+
+void UAVSensorAppFedAvg::sendConsensusSamples() {
+    // La station de base n'agrège rien : elle échantillonne les modèles pour mesurer le consensus
+    for (auto& job : jobs) {
+        sendLocalModel(job, CONSENSUS_SAMPLE, baseStationAddress);
+    }
+}
+
+void UAVSensorAppFedAvg::updateNeighbour(const FedAvgMessage *msg, L3Address srcAddr) {
+    GossipNeighbour& neighbour = neighbours[msg->getUavId()];
+    neighbour.address = srcAddr;
+    neighbour.lastSeen = simTime();
+    neighbour.degree = msg->getDegree();
+}
+
+void UAVSensorAppFedAvg::mixModel(UavJob& job, const FedAvgMessage *msg) {
+    FederatedLearningModel peerModel(job.localModel);
+    if (!peerModel.deserialize(msg->getModelWeights())) {
+        EV_WARN << "UAV[" << uavId << "] cannot deserialize model from UAV " << msg->getUavId() << endl;
+        return;
+    }
+
+    // Poids de Metropolis-Hastings : symétriques, ils préservent la moyenne des modèles
+    // de l'essaim et ne demandent que les degrés des deux voisins
+    double weight = mixingWeight;
+    if (weight < 0) {
+        weight = 1.0 / (1 + std::max(static_cast<int>(neighbours.size()), msg->getDegree()));
+    }
+
+    std::vector<double> mixed = job.localModel.getWeights();
+    const std::vector<double>& peerWeights = peerModel.getWeights();
+    for (size_t i = 0; i < mixed.size(); i++) {
+        mixed[i] = (1 - weight) * mixed[i] + weight * peerWeights[i];
+    }
+    job.localModel.setWeights(mixed);
+
+    numGossipExchanges++;
+    emit(mixingWeightSignal, weight);
 }
 
 void UAVSensorAppFedAvg::socketDataArrived(UdpSocket *socket, Packet *packet) {
@@ -250,34 +815,98 @@ void UAVSensorAppFedAvg::socketDataArrived(UdpSocket *socket, Packet *packet) {
     // Vérifier si c'est un message FedAvg
     auto chunk = packet->peekAtFront<Chunk>();
     if (auto fedAvgMsg = dynamicPtrCast<const FedAvgMessage>(chunk)) {
-        processFedAvgMessage(fedAvgMsg.get()->dup());
+        processFedAvgMessage(fedAvgMsg.get()->dup(), srcAddr);
     }
 
     delete packet;
 }
 
-void UAVSensorAppFedAvg::processFedAvgMessage(FedAvgMessage *msg) {
-    if (msg->getMessageType() == GLOBAL_UPDATE) {
+void UAVSensorAppFedAvg::processFedAvgMessage(FedAvgMessage *msg, L3Address srcAddr) {
+    int messageType = msg->getMessageType();
+
+    // Tout message d'un autre UAV atteste de son voisinage
+    if (gossipMode && msg->getUavId() >= 0 && msg->getUavId() != uavId &&
+            (messageType == NEIGHBOUR_HELLO || messageType == GOSSIP_MODEL || messageType == GOSSIP_REPLY)) {
+        updateNeighbour(msg, srcAddr);
+    }
+    if (messageType == NEIGHBOUR_HELLO) {
+        delete msg;
+        return;
+    }
+
+    int jobId = msg->getJobId();
+    if (jobId < 0 || jobId >= numJobs) {
+        EV_WARN << "UAV[" << uavId << "] ignoring message for unknown job " << jobId << endl;
+        delete msg;
+        return;
+    }
+    UavJob& job = jobs[jobId];
+
+    if (messageType == GOSSIP_MODEL || messageType == GOSSIP_REPLY) {
+        if (gossipMode) {
+            // Échange symétrique : renvoyer le modèle local avant le mélange, pour que
+            // les deux voisins appliquent le même poids et conservent leur moyenne
+            if (messageType == GOSSIP_MODEL) {
+                sendLocalModel(job, GOSSIP_REPLY, srcAddr);
+            }
+            mixModel(job, msg);
+        }
+    }
+    else if (messageType == GLOBAL_UPDATE) {
         int roundId = msg->getRoundId();
 
-        EV_INFO << "UAV[" << uavId << "] received global model update for round " << roundId << endl;
+        EV_INFO << "UAV[" << uavId << "] received global model version " << msg->getModelVersion()
+                << " for job " << jobId << ", round " << roundId << endl;
+
+        // Version déjà reçue (instantané croisant un delta appliqué, par exemple)
+        if (msg->getModelVersion() <= job.globalVersion) {
+            delete msg;
+            return;
+        }
+
+        // Reconstruire la nouvelle version ; sans la version de référence, demander l'instantané complet
+        if (!updateGlobalModel(job, msg)) {
+            requestGlobalSnapshot(job);
+            delete msg;
+            return;
+        }
+
+        // Une mise à jour de la ronde précédente encore en calcul ou en attente est abandonnée
+        if (job.computeTimer->isScheduled() || job.uploadTimer->isScheduled()) {
+            cancelEvent(job.computeTimer);
+            cancelEvent(job.uploadTimer);
+            job.trainingInProgress = false;
+            updateComputePower();
+        }
+        if (job.lastUpload != nullptr) {
+            completeModelUpload(job, false);
+        }
 
         // Mettre à jour notre ronde actuelle
-        currentRound = roundId;
+        job.currentRound = roundId;
+        job.roundDeadline = msg->getRoundDeadline();
 
-        // Mettre à jour notre modèle local avec le modèle global
-        localModel.deserialize(msg->getModelWeights());
+        // Le modèle local lit l'instantané partagé jusqu'à sa première écriture (entraînement)
+        job.localModel.shareWeights(job.globalWeights);
+        emitModelMemory();
 
         // Planifier l'entraînement local
-        if (!trainingInProgress) {
-            trainingInProgress = true;
+        if (!job.trainingInProgress) {
+            job.trainingInProgress = true;
             // Ajouter un petit délai pour éviter que tous les UAVs s'entraînent exactement en même temps
             simtime_t trainDelay = 0.1 + 0.05 * uavId;
-            scheduleAt(simTime() + trainDelay, trainTimer);
+            scheduleAt(simTime() + trainDelay, job.trainTimer);
 
             EV_INFO << "UAV[" << uavId << "] scheduled local training in " << trainDelay << "s" << endl;
         }
     }
+    else if (messageType == UPLOAD_ACK) {
+        if (msg->getRoundId() == job.currentRound && job.lastUpload != nullptr) {
+            EV_INFO << "UAV[" << uavId << "] model update for job " << jobId << ", round "
+                    << job.currentRound << " acknowledged" << endl;
+            completeModelUpload(job, true);
+        }
+    }
 
     delete msg;
 }
@@ -288,7 +917,7 @@ void UAVSensorAppFedAvg::socketErrorArrived(UdpSocket *socket, Indication *indic
 }
 
 void UAVSensorAppFedAvg::socketClosed(UdpSocket *socket) {
-    if (operationalState == State::STOPPING_OPERATION) {
+    if (operationalState == State::STOPPING_OPERATION && !this->socket.isOpen() && !fedAvgSocket.isOpen()) {
         startActiveOperationExtraTimeOrFinish(par("stopOperationExtraTime"));
     }
 }
@@ -296,35 +925,77 @@ void UAVSensorAppFedAvg::socketClosed(UdpSocket *socket) {
 void UAVSensorAppFedAvg::handleStartOperation(LifecycleOperation *operation) {
     socket.setOutputGate(gate("socketOut"));
     socket.setCallback(this);
-    // Remove the duplicate socket binding from here
     // Only bind if localPort is valid
     if (localPort > 0 && !socket.isOpen()) {
         socket.bind(localPort);
     }
 
+    // Socket FedAvg séparé pour que les modèles ne partagent pas la file de la télémétrie
+    fedAvgSocket.setOutputGate(gate("socketOut"));
+    fedAvgSocket.setCallback(this);
+    if (!fedAvgSocket.isOpen()) {
+        fedAvgSocket.bind(fedAvgPort);
+        if (gossipMode) {
+            // Les annonces de voisinage sont diffusées en broadcast
+            fedAvgSocket.setBroadcast(true);
+        }
+    }
+
+    // Résolution de l'adresse de la station de base pour les données normales
+    if (destAddress.isUnspecified()) {
+        const char *destAddrs = par("destAddresses");
+        cStringTokenizer tokenizer(destAddrs);
+        const char *token;
+
+        while ((token = tokenizer.nextToken()) != nullptr) {
+            L3AddressResolver().tryResolve(token, destAddress);
+            if (destAddress.isUnspecified())
+                EV_ERROR << "Cannot resolve destination address: " << token << endl;
+            baseStationAddress = destAddress; // Utiliser la même adresse pour FedAvg
+            break;
+        }
+    }
+
     if (!destAddress.isUnspecified()) {
-        sendTimer = new cMessage("sendTimer");
-        trainTimer = new cMessage("trainTimer");
         scheduleAt(simTime() + par("startTime"), sendTimer);
     }
+    if (gossipMode) {
+        startGossip();
+    }
 }
 
 void UAVSensorAppFedAvg::handleStopOperation(LifecycleOperation *operation) {
     cancelEvent(sendTimer);
-    cancelEvent(trainTimer);
+    cancelJobTimers();
+    stopGossip();
+    pendingTelemetry.clear();
     socket.close();
+    fedAvgSocket.close();
     delayActiveOperationFinish(par("stopOperationTimeout"));
 }
 
 void UAVSensorAppFedAvg::handleCrashOperation(LifecycleOperation *operation) {
     cancelEvent(sendTimer);
-    cancelEvent(trainTimer);
+    cancelJobTimers();
+    stopGossip();
+    pendingTelemetry.clear();
     socket.destroy();
+    fedAvgSocket.destroy();
 }
 
 void UAVSensorAppFedAvg::finish() {
     ApplicationBase::finish();
     EV_INFO << "UAV[" << uavId << "] Sensor App FedAvg finished. Sent: " << numSent
             << " packets, Received: " << numReceived << " packets." << endl;
-    EV_INFO << "Participated in " << currentRound << " rounds of federated learning." << endl;
+    for (const auto& job : jobs) {
+        EV_INFO << "Participated in " << job.currentRound << " rounds of federated learning for job " << job.jobId << "." << endl;
+    }
+
+    recordScalar("uploadsLost", numUploadsLost);
+    recordScalar("fedAvgBytesSent", fedAvgBytesSent, "B");
+    recordScalar("computeEnergy", computeEnergy, "J");
+    recordScalar("radioEnergy", radioEnergy, "J");
+    if (gossipMode) {
+        recordScalar("gossipExchanges", numGossipExchanges);
+    }
 }
@@ -6,16 +6,62 @@
 #include "inet/transportlayer/contract/udp/UdpSocket.h"
 #include "inet/common/lifecycle/LifecycleOperation.h"
 #include "inet/common/packet/Packet.h"
+#include "inet/mobility/contract/IMobility.h"
+#include "inet/power/contract/IEpEnergyConsumer.h"
+#include "inet/power/contract/IEpEnergyStorage.h"
 #include "FederatedLearningModel.h"
+#include "SharedModelRegistry.h"
 #include "FedAvgMessage_m.h"
 
 using namespace omnetpp;
 using namespace inet;
 
 /**
- * Application UAV implémentant l'algorithme d'apprentissage fédéré (FedAvg)
+ * État local d'une tâche d'apprentissage fédéré ; un UAV participe à plusieurs
+ * tâches indépendantes multiplexées par la station de base (identifiées par jobId)
  */
-class UAVSensorAppFedAvg : public ApplicationBase, public UdpSocket::ICallback {
+struct UavJob {
+    int jobId = 0;
+    int currentRound = 0;              // Ronde d'apprentissage actuelle
+    bool trainingInProgress = false;
+    simtime_t roundDeadline;           // Échéance de la ronde actuelle
+    FederatedLearningModel localModel; // Modèle local
+    int globalVersion = 0;             // Version du modèle global détenue (0 : aucune)
+    SharedModelRegistry::Snapshot globalWeights; // Poids de cette version (partagés entre UAVs), base des deltas suivants
+                                                 // (libérés après l'entraînement sans deltaDownlink)
+
+    // Données synthétiques pour l'entraînement
+    std::vector<std::pair<std::vector<double>, double>> trainingData;
+    std::vector<std::pair<std::vector<double>, double>> holdoutData; // Échantillons réservés à l'évaluation
+    unsigned long dataGeneration = 0;  // Génération des données locales (clé du cache des métriques)
+    unsigned long trainedGeneration = 0; // Génération des données du dernier entraînement
+
+    Packet *lastUpload = nullptr;      // Copie de la dernière mise à jour, pour retransmission
+    int uploadRetries = 0;             // Retransmissions de la mise à jour en cours
+    int localSteps = 0;                // Pas de gradient de la dernière mise à jour
+    cMessage *trainTimer = nullptr;
+    cMessage *computeTimer = nullptr;   // Fin du calcul de l'entraînement local
+    cMessage *uploadTimer = nullptr;    // Envoi différé de la mise à jour
+    cMessage *uploadAckTimer = nullptr; // Attente de l'accusé de réception
+
+    UavJob() : localModel(5, 0.01, 32, 3) {}
+};
+
+/**
+ * Voisin à un saut découvert par les annonces HELLO (mode gossip)
+ */
+struct GossipNeighbour {
+    L3Address address;
+    simtime_t lastSeen;  // Dernière annonce ou dernier échange reçu de ce voisin
+    int degree = 0;      // Nombre de voisins annoncé par ce voisin
+};
+
+/**
+ * Application UAV implémentant l'algorithme d'apprentissage fédéré (FedAvg).
+ * Avec un stockage d'énergie INET, l'application est aussi le consommateur de la
+ * puissance de calcul de l'entraînement local.
+ */
+class UAVSensorAppFedAvg : public ApplicationBase, public UdpSocket::ICallback, public power::IEpEnergyConsumer {
   protected:
     // Configuration
     int localPort = -1;
@@ -24,28 +70,95 @@ class UAVSensorAppFedAvg : public ApplicationBase, public UdpSocket::ICallback {
     L3Address destAddress;     // Adresse de la station de base
     L3Address baseStationAddress; // Adresse de la station de base pour FedAvg
 
+    // Classes de trafic (DSCP, la priorité 802.11e en est dérivée)
+    int fedAvgDscp = 46;       // Trafic FedAvg (modèles)
+    int telemetryDscp = 8;     // Télémétrie des capteurs
+
+    // Regroupement de la télémétrie
+    int telemetryBatchSize = 1;       // Nombre de relevés par trame de télémétrie
+    bool piggybackTelemetry = false;  // Ajouter la télémétrie en attente aux envois de modèle
+    std::vector<simtime_t> pendingTelemetry; // Horodatages des relevés en attente d'envoi
+
+    // Coût de calcul de l'entraînement local
+    double deviceFlops = 0;           // Vitesse de calcul de l'UAV en FLOP/s (0 : entraînement instantané)
+    double computeScale = 1;          // Facteur appliqué aux FLOPs estimés (modèle embarqué plus gros)
+    bool adaptiveLocalWork = false;   // Adapter le nombre de pas locaux au budget de temps
+    simtime_t localTimeBudget;        // Budget de calcul par ronde
+    int maxLocalSteps = 100;          // Nombre maximal de pas locaux en mode adaptatif
+    double holdoutFraction = 0;       // Part des données locales réservée à l'évaluation
+
+    // Énergie de l'apprentissage
+    double computeEnergyPerFlop = 0;  // Énergie d'une opération flottante (J)
+    double radioEnergyPerBit = 0;     // Énergie d'émission d'un bit FedAvg (J)
+    double batteryCapacity = 0;       // Budget d'énergie sans stockage INET (J, 0 : illimité)
+    double lowEnergyThreshold = 0.2;  // Niveau de batterie sous lequel le travail local est réduit
+    power::IEpEnergyStorage *energyStorage = nullptr; // Stockage d'énergie du nœud, s'il est configuré
+    W computePowerConsumption = W(0); // Puissance de calcul actuellement tirée du stockage
+    double computeEnergy = 0;         // Énergie consommée par l'entraînement local (J)
+    double radioEnergy = 0;           // Énergie consommée par l'émission des messages FedAvg (J)
+
+    // Planification des envois selon la mobilité
+    bool mobilityAwareUpload = false; // Différer l'envoi au point de l'orbite le plus proche de la station de base
+    simtime_t uploadLookahead;        // Fenêtre de prédiction de la trajectoire
+    simtime_t uploadGuardTime;        // Marge laissée avant l'échéance de la ronde
+    simtime_t predictionStep;         // Pas d'échantillonnage de la trajectoire prédite
+    simtime_t uploadAckTimeout;       // Délai d'attente de l'accusé de réception
+    int maxUploadRetries = 0;         // Nombre maximal de retransmissions d'une mise à jour
+    IMobility *mobility = nullptr;    // Mobilité du nœud
+    double orbitRadius = 0;           // Rayon de l'orbite (0 si la mobilité n'est pas circulaire)
+    Coord orbitCentre;                // Centre de l'orbite
+    Coord baseStationPosition;        // Position de la station de base
+    bool baseStationPositionKnown = false;
+
+    // Mode décentralisé (gossip) : moyenne des modèles entre voisins à un saut
+    bool gossipMode = false;
+    simtime_t gossipInterval;          // Période des échanges de modèles
+    int gossipFanout = 2;              // Voisins contactés à chaque échange
+    double mixingWeight = -1;          // Poids du modèle reçu (négatif : Metropolis-Hastings)
+    simtime_t helloInterval;           // Période des annonces de voisinage
+    simtime_t neighbourTimeout;        // Validité d'un voisin sans nouvelle annonce
+    simtime_t consensusReportInterval; // Période d'envoi du modèle local à la station de base
+    std::map<int, GossipNeighbour> neighbours; // Voisins à un saut, indexés par uavId
+    cMessage *helloTimer = nullptr;
+    cMessage *gossipTimer = nullptr;
+    cMessage *consensusTimer = nullptr;
+
     // État
-    UdpSocket socket;
+    UdpSocket socket;          // Socket de télémétrie
+    UdpSocket fedAvgSocket;    // Socket dédié à la communication FedAvg
     cMessage *sendTimer = nullptr;
-    cMessage *trainTimer = nullptr;
     simtime_t sendInterval;
 
     // État FedAvg
     int uavId;                // ID de l'UAV dans le réseau
-    int currentRound = 0;     // Ronde d'apprentissage actuelle
-    bool trainingInProgress = false;
-    FederatedLearningModel localModel;  // Modèle local
-
-    // Données synthétiques pour l'entraînement
-    std::vector<std::pair<std::vector<double>, double>> trainingData;
+    int numJobs = 1;          // Nombre de tâches d'apprentissage
+    std::vector<UavJob> jobs; // État par tâche, indexé par jobId
+    bool deltaDownlink = false; // La station de base envoie des deltas : garder la version reçue comme référence
+    std::string runId;        // Run courant, qui délimite le partage des instantanés du modèle global
 
     // Statistiques
     int numSent = 0;
     int numReceived = 0;
+    int numUploadsLost = 0;
+    long fedAvgBytesSent = 0;  // Octets envoyés sur le socket FedAvg (mises à jour, gossip, annonces)
+    int numGossipExchanges = 0;
     static simsignal_t sentPkSignal;
     static simsignal_t rcvdPkSignal;
     simsignal_t trainingCompletedSignal;
     simsignal_t localAccuracySignal;
+    simsignal_t telemetryBatchSignal;
+    simsignal_t uploadDistanceSignal;
+    simsignal_t uploadDeferralSignal;
+    simsignal_t uploadRetriesSignal;
+    simsignal_t fedAvgBytesSentSignal;
+    simsignal_t neighboursSignal;
+    simsignal_t mixingWeightSignal;
+    simsignal_t privateModelBytesSignal;
+    simsignal_t sharedModelBytesSignal;
+    simsignal_t localStepsSignal;
+    simsignal_t computeTimeSignal;
+    simsignal_t energyConsumedSignal;
+    simsignal_t batteryLevelSignal;
 
   protected:
     virtual void initialize(int stage) override;
@@ -55,15 +168,49 @@ class UAVSensorAppFedAvg : public ApplicationBase, public UdpSocket::ICallback {
     // Méthodes d'application
     virtual void sendSensorData();
     virtual void collectSensorData();
+    virtual void flushTelemetry();
+    virtual void appendPendingTelemetry(Packet *packet);
 
     // Méthodes FedAvg
-    virtual void trainLocalModel();
-    virtual void sendModelUpdate();
-    virtual void generateSyntheticData();
-    virtual double evaluateModel();
+    virtual void trainLocalModel(UavJob& job);
+    virtual int computeLocalSteps(UavJob& job);
+    virtual void completeLocalTraining(UavJob& job);
+    virtual void scheduleModelUpload(UavJob& job);
+    virtual void sendModelUpdate(UavJob& job);
+    virtual void retransmitModelUpdate(UavJob& job);
+    virtual void completeModelUpload(UavJob& job, bool acknowledged);
+    virtual void generateSyntheticData(UavJob& job);
+    virtual double evaluateModel(UavJob& job);
+    virtual bool isRoundActive() const;
+    virtual void createJobTimers();
+    virtual void cancelJobTimers();
+    virtual bool updateGlobalModel(UavJob& job, const FedAvgMessage *msg);
+    virtual void requestGlobalSnapshot(UavJob& job);
+    virtual void emitModelMemory();
+    virtual void sendFedAvgPacket(Packet *packet, L3Address destAddr);
+
+    // Énergie
+    virtual double getBatteryLevel() const;
+    virtual void updateComputePower();
+    virtual void emitEnergy();
+
+    // Mode gossip
+    virtual void startGossip();
+    virtual void stopGossip();
+    virtual void sendHello();
+    virtual void gossipRound();
+    virtual void pruneNeighbours();
+    virtual void sendLocalModel(UavJob& job, int messageType, L3Address destAddr);
+    virtual void sendConsensusSamples();
+    virtual void updateNeighbour(const FedAvgMessage *msg, L3Address srcAddr);
+    virtual void mixModel(UavJob& job, const FedAvgMessage *msg);
+
+    // Prédiction de la trajectoire
+    virtual Coord predictPosition(simtime_t delta);
+    virtual bool resolveBaseStationPosition();
 
     // Méthodes de traitement des messages
-    virtual void processFedAvgMessage(FedAvgMessage *msg);
+    virtual void processFedAvgMessage(FedAvgMessage *msg, L3Address srcAddr);
 
     // Méthodes du socket
     virtual void socketDataArrived(UdpSocket *socket, Packet *packet) override;
@@ -78,6 +225,10 @@ class UAVSensorAppFedAvg : public ApplicationBase, public UdpSocket::ICallback {
   public:
     UAVSensorAppFedAvg();
     virtual ~UAVSensorAppFedAvg();
+
+    // IEpEnergyConsumer
+    virtual power::IEnergySource *getEnergySource() const override { return energyStorage; }
+    virtual W getPowerConsumption() const override { return computePowerConsumption; }
 };
 
 #endif
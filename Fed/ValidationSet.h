@@ -0,0 +1,113 @@
+#ifndef __VALIDATIONSET_H
+#define __VALIDATIONSET_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Métriques d'un modèle sur un jeu de validation
+ */
+struct ValidationMetrics {
+    double mae = 0.0;  // Erreur absolue moyenne
+    double mse = 0.0;  // Erreur quadratique moyenne
+    double r2 = 0.0;   // Coefficient de détermination
+};
+
+/**
+ * Jeu de validation stocké par colonnes (une colonne contiguë par feature)
+ * pour que l'évaluation d'un lot se réduise à des boucles vectorisables
+ * sur des tableaux plats, sans vecteur alloué par échantillon.
+ */
+class ValidationSet {
+protected:
+    static const size_t BLOCK_SIZE = 256;  // Échantillons évalués par bloc (prédictions en cache L1)
+
+    int dimension = 0;
+    size_t numSamples = 0;
+    std::vector<double> features;  // features[j * numSamples + i] : feature j de l'échantillon i
+    std::vector<double> targets;
+    double targetMean = 0.0;
+    double targetVariance = 0.0;   // Somme des carrés des écarts à la moyenne
+
+public:
+    /**
+     * Construit le jeu de validation à partir d'échantillons (inputs, output)
+     * @param data Échantillons de validation
+     */
+    void assign(const std::vector<std::pair<std::vector<double>, double>>& data) {
+        numSamples = data.size();
+        dimension = data.empty() ? 0 : data.front().first.size();
+        features.assign(dimension * numSamples, 0.0);
+        targets.resize(numSamples);
+
+        for (size_t i = 0; i < numSamples; i++) {
+            for (int j = 0; j < dimension; j++) {
+                features[j * numSamples + i] = data[i].first[j];
+            }
+            targets[i] = data[i].second;
+        }
+
+        targetMean = 0.0;
+        for (double y : targets) {
+            targetMean += y;
+        }
+        targetMean = numSamples > 0 ? targetMean / numSamples : 0.0;
+        targetVariance = 0.0;
+        for (double y : targets) {
+            targetVariance += (y - targetMean) * (y - targetMean);
+        }
+    }
+
+    size_t size() const {
+        return numSamples;
+    }
+
+    bool empty() const {
+        return numSamples == 0;
+    }
+
+    /**
+     * Évalue un modèle linéaire (biais puis poids) sur tout le jeu de validation
+     * @param weights Poids du modèle, weights[0] étant le biais
+     * @return MAE, MSE et R²
+     */
+    ValidationMetrics evaluate(const std::vector<double>& weights) const {
+        ValidationMetrics metrics;
+        if (numSamples == 0 || weights.size() != static_cast<size_t>(dimension) + 1) {
+            return metrics;
+        }
+
+        double absoluteSum = 0.0;
+        double squaredSum = 0.0;
+        double predictions[BLOCK_SIZE];
+
+        for (size_t start = 0; start < numSamples; start += BLOCK_SIZE) {
+            size_t count = std::min(BLOCK_SIZE, numSamples - start);
+
+            // Prédictions du bloc, une feature à la fois sur une colonne contiguë
+            std::fill(predictions, predictions + count, weights[0]);
+            for (int j = 0; j < dimension; j++) {
+                const double w = weights[j + 1];
+                const double *column = features.data() + j * numSamples + start;
+                for (size_t i = 0; i < count; i++) {
+                    predictions[i] += w * column[i];
+                }
+            }
+
+            const double *y = targets.data() + start;
+            for (size_t i = 0; i < count; i++) {
+                double error = predictions[i] - y[i];
+                absoluteSum += std::abs(error);
+                squaredSum += error * error;
+            }
+        }
+
+        metrics.mae = absoluteSum / numSamples;
+        metrics.mse = squaredSum / numSamples;
+        metrics.r2 = targetVariance > 0 ? 1.0 - squaredSum / targetVariance : 0.0;
+        return metrics;
+    }
+};
+
+#endif